@@ -0,0 +1,708 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// microbenchmarks for the individual update subsystems of the plugin
+//
+// the plugin source is compiled into this translation unit so that its static
+// update functions can be called directly with prepared input snapshots
+
+#include "../hughes_500d.cpp"
+
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// define benchmark parameters
+#define INPUT_FRAMES 1024
+#define BATCH_CALLS 4096
+#define BATCHES 64
+#define WARMUP_BATCHES 4
+#define INSTANCE_FRAMES 64
+
+typedef void (*Subsystem_f)(const InstanceInputs *inputs, InstanceOutputs *outputs, int count);
+
+struct Subsystem
+{
+    const char *name;
+    Subsystem_f update;
+};
+
+typedef void (*Regime_f)(SimInputs *inputs, float time);
+
+struct Regime
+{
+    const char *name;
+    Regime_f fill;
+};
+
+static void BenchDoors(const InstanceInputs *inputs, InstanceOutputs *outputs, int count)
+{
+    UpdateDoors(inputs, inputs->frameRatePeriod, count);
+}
+
+static void BenchPilot(const InstanceInputs *inputs, InstanceOutputs *outputs, int count)
+{
+    UpdatePilot(inputs, inputs->frameRatePeriod, count);
+}
+
+static void BenchSwitches(const InstanceInputs *inputs, InstanceOutputs *outputs, int count)
+{
+    UpdateSwitches(inputs, count);
+}
+
+// the blade dynamics alone, the blade count is normally checked by the pitch
+static void BenchBlades(const InstanceInputs *inputs, InstanceOutputs *outputs, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (instances.bladeCount[i] != (int) inputs->acfNumBlades[i])
+            SelectBladePitchKernel(i, (int) inputs->acfNumBlades[i]);
+    }
+
+    UpdateBladeDynamics(inputs, count);
+}
+
+
+static const Subsystem subsystems[] =
+{
+    {"doors", BenchDoors},
+    {"rotor", UpdateRotor},
+    {"blades", BenchBlades},
+    {"pilot", BenchPilot},
+    {"switches", BenchSwitches},
+    {"shudder", UpdateTransitionalShudder},
+    {"reference", UpdateReference},
+    {"fused", UpdateFused}
+};
+
+// inputs common to all regimes
+static void FillCommon(SimInputs *inputs, float time)
+{
+    memset(inputs, 0, sizeof(SimInputs));
+    inputs->tuning = defaultTuning;
+    inputs->frameRatePeriod = 1.0f / 60.0f;
+    inputs->acfNumBlades = 5.0f;
+    inputs->acfCyclicAiln = 10.0f;
+    inputs->acfCyclicElev = 12.0f;
+    inputs->pointPitchDeg = 4.0f;
+    inputs->localX = 100.0f;
+    inputs->localZ = -50.0f;
+    inputs->viewX = 100.0f + 3.0f * cosf(time * 0.2f);
+    inputs->viewZ = -50.0f + 3.0f * sinf(time * 0.2f);
+    inputs->psi = 90.0f;
+    inputs->audioPanelOut = 0;
+}
+
+// rotor at idle below the muting threshold, aircraft parked with doors closed
+static void FillGroundIdle(SimInputs *inputs, float time)
+{
+    FillCommon(inputs, time);
+    inputs->ongroundAny = 1;
+    inputs->pointTacrad[0] = 10.0f;
+    inputs->pointTacrad[1] = 60.0f;
+    inputs->cyclicElevDiscTilt = 0.5f * sinf(time);
+    inputs->cyclicAilnDiscTilt = 0.5f * cosf(time);
+}
+
+// rotor at flight rpm, small cyclic inputs around a stable hover
+static void FillHover(SimInputs *inputs, float time)
+{
+    FillCommon(inputs, time);
+    inputs->pointTacrad[0] = 50.0f;
+    inputs->pointTacrad[1] = 300.0f;
+    inputs->pointTacrad[4] = 2.0f * sinf(time);
+    inputs->pointTacrad[5] = 2.0f * cosf(time);
+    inputs->yolkPitchRatio = 0.05f * sinf(time * 0.5f);
+    inputs->yolkRollRatio = 0.05f * cosf(time * 0.5f);
+    inputs->phi = 2.0f * sinf(time * 0.3f);
+    inputs->pDot = 0.1f * sinf(time * 2.0f);
+    inputs->qDot = 0.1f * cosf(time * 2.0f);
+    inputs->audioPanelOut = 10;
+}
+
+// accelerating through transitional lift with large cyclic and shudder terms
+static void FillTransitionalLift(SimInputs *inputs, float time)
+{
+    FillCommon(inputs, time);
+    inputs->pointTacrad[0] = 52.0f;
+    inputs->pointTacrad[1] = 310.0f;
+    inputs->pointTacrad[4] = 20.0f + 10.0f * sinf(time * 3.0f);
+    inputs->pointTacrad[5] = 20.0f + 10.0f * cosf(time * 3.0f);
+    inputs->yolkPitchRatio = -0.4f + 0.1f * sinf(time);
+    inputs->yolkRollRatio = 0.2f * cosf(time * 0.7f);
+    inputs->phi = 15.0f * sinf(time * 0.2f);
+    inputs->pDot = 0.8f * sinf(time * 5.0f);
+    inputs->qDot = 0.8f * cosf(time * 5.0f);
+    inputs->audioPanelOut = 2;
+}
+
+// parked at idle while the doors are opened and closed every two seconds
+static void FillDoorsCycling(SimInputs *inputs, float time)
+{
+    FillGroundIdle(inputs, time);
+    inputs->flaprqst = fmodf(time, 4.0f) < 2.0f ? 1.0f : 0.0f;
+}
+
+static const Regime regimes[] =
+{
+    {"hover", FillHover},
+    {"transitional lift", FillTransitionalLift},
+    {"ground idle", FillGroundIdle},
+    {"doors cycling", FillDoorsCycling}
+};
+
+static SimInputs inputFrames[INPUT_FRAMES];
+static InstanceInputs instanceFrames[INSTANCE_FRAMES];
+
+static int OpenInstructionCounter(void)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static double Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void RunBenchmark(const Subsystem *subsystem, const Regime *regime, int instructionCounter)
+{
+    for (int i = 0; i < INPUT_FRAMES; i++)
+        regime->fill(&inputFrames[i], i / 60.0f);
+
+    ResetInstances();
+
+    // the inputs are stored into lane 0 on every call, like the plugin does
+    // with the snapshot it reads from the sim
+    InstanceInputs inputs;
+    InstanceOutputs outputs;
+    memset(&inputs, 0, sizeof(inputs));
+    double sum = 0.0, sumSquares = 0.0;
+    long long instructions = 0;
+    int frame = 0;
+
+    for (int batch = 0; batch < WARMUP_BATCHES + BATCHES; batch++)
+    {
+        if (instructionCounter >= 0)
+        {
+            ioctl(instructionCounter, PERF_EVENT_IOC_RESET, 0);
+            ioctl(instructionCounter, PERF_EVENT_IOC_ENABLE, 0);
+        }
+
+        double start = Now();
+        for (int call = 0; call < BATCH_CALLS; call++)
+        {
+            SetInstanceInputs(&inputs, 0, &inputFrames[frame]);
+            subsystem->update(&inputs, &outputs, 1);
+            frame = (frame + 1) & (INPUT_FRAMES - 1);
+        }
+        double nsPerCall = (Now() - start) * 1e9 / BATCH_CALLS;
+
+        long long count = 0;
+        if (instructionCounter >= 0)
+        {
+            ioctl(instructionCounter, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(instructionCounter, &count, sizeof(count)) != sizeof(count))
+                count = 0;
+        }
+
+        if (batch < WARMUP_BATCHES)
+            continue;
+
+        sum += nsPerCall;
+        sumSquares += nsPerCall * nsPerCall;
+        instructions += count;
+    }
+
+    double mean = sum / BATCHES;
+    double variance = sumSquares / BATCHES - mean * mean;
+    if (variance < 0.0)
+        variance = 0.0;
+
+    printf("%-10s %-18s %10.2f %12.4f", subsystem->name, regime->name, mean, variance);
+    if (instructionCounter >= 0)
+        printf(" %12.1f\n", (double) instructions / ((double) BATCHES * BATCH_CALLS));
+    else
+        printf(" %12s\n", "n/a");
+}
+
+// fills the lanes of count instances from a regime, every instance runs
+// through the regime with its own time offset
+static void FillInstances(InstanceInputs *inputs, const Regime *regime, float time, int count)
+{
+    memset(inputs, 0, sizeof(InstanceInputs));
+
+    for (int i = 0; i < count; i++)
+    {
+        SimInputs snapshot;
+        regime->fill(&snapshot, time + i * 0.37f);
+        SetInstanceInputs(inputs, i, &snapshot);
+    }
+}
+
+// times the fused kernel over a growing number of instances in the hover
+// regime, the cost per instance shows how the batch scales
+static void BenchInstances(void)
+{
+    const int counts[] = {1, 2, 4, 8, 16, MAX_INSTANCES};
+
+    printf("%-10s %12s %14s\n", "instances", "ns/frame", "ns/instance");
+
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+    {
+        int count = counts[c];
+        for (int i = 0; i < INSTANCE_FRAMES; i++)
+            FillInstances(&instanceFrames[i], &regimes[0], i / 60.0f, count);
+
+        ResetInstances();
+
+        InstanceOutputs outputs;
+        double best = 0.0;
+
+        for (int batch = 0; batch < WARMUP_BATCHES + BATCHES; batch++)
+        {
+            double start = Now();
+            for (int call = 0; call < BATCH_CALLS; call++)
+                UpdateFused(&instanceFrames[call & (INSTANCE_FRAMES - 1)], &outputs, count);
+            double nsPerCall = (Now() - start) * 1e9 / BATCH_CALLS;
+
+            if (batch >= WARMUP_BATCHES && (best == 0.0 || nsPerCall < best))
+                best = nsPerCall;
+        }
+
+        printf("%-10d %12.2f %14.2f\n", count, best, best / count);
+    }
+}
+
+// plays MAX_TRACKS tracks of twelve cubic keys each at 60 fps, every track
+// with its own time offset, and reports the cost of evaluating all of them
+static void BenchTracks(void)
+{
+    static char text[MAX_TRACKS * 12 * 32 + MAX_TRACKS * 32];
+    static TrackTable table;
+    static int cursors[MAX_TRACKS];
+    size_t length = 0;
+
+    for (int t = 0; t < MAX_TRACKS; t++)
+    {
+        length += snprintf(text + length, sizeof(text) - length, "track part%d\n", t);
+        for (int k = 0; k < 12; k++)
+            length += snprintf(text + length, sizeof(text) - length, "%.2f %.3f %.3f\n", k * 0.5f, sinf(k + t * 0.1f), cosf(k + t * 0.1f) * 2.0f);
+    }
+
+    char error[128];
+    if (!TrackCompile(&table, text, error, sizeof(error)))
+    {
+        printf("cannot compile benchmark tracks, %s\n", error);
+        return;
+    }
+
+    volatile float sink = 0.0f;
+    double best = 1e30;
+    for (int batch = 0; batch < BATCHES; batch++)
+    {
+        double start = Now();
+        for (int frame = 0; frame < 6 * 60; frame++)
+        {
+            float sum = 0.0f;
+            for (int t = 0; t < MAX_TRACKS; t++)
+                sum += TrackEvaluate(&table, t, frame / 60.0f + t * (1.0f / MAX_TRACKS), &cursors[t]);
+            sink = sink + sum;
+        }
+        double ns = (Now() - start) * 1e9 / (6 * 60);
+        best = ns < best ? ns : best;
+    }
+
+    printf("tracks: %d tracks of %d segments in %.2f ns per frame\n", table.trackCount, table.segmentCount / table.trackCount, best);
+}
+
+struct State
+{
+    InstanceState instances;
+    InstanceOutputs outputs;
+};
+
+static void SaveState(State *state, const InstanceOutputs *outputs)
+{
+    memcpy(&state->instances, &instances, sizeof(InstanceState));
+    memcpy(&state->outputs, outputs, sizeof(InstanceOutputs));
+}
+
+static void LoadState(const State *state, InstanceOutputs *outputs)
+{
+    memcpy(&instances, &state->instances, sizeof(InstanceState));
+    memcpy(outputs, &state->outputs, sizeof(InstanceOutputs));
+}
+
+// runs the fused kernel and the reference path side by side over every
+// regime with all instances and reports the first frame whose state differs
+// in any bit
+static int CheckFusedEquivalence(void)
+{
+    int equivalent = 1;
+
+    for (size_t r = 0; r < sizeof(regimes) / sizeof(regimes[0]); r++)
+    {
+        State reference, fused;
+        InstanceOutputs outputs;
+        memset(&outputs, 0, sizeof(outputs));
+
+        ResetInstances();
+        SaveState(&reference, &outputs);
+        fused = reference;
+
+        for (int frame = 0; frame < 60 * 60; frame++)
+        {
+            InstanceInputs inputs;
+            FillInstances(&inputs, &regimes[r], frame / 60.0f, MAX_INSTANCES);
+
+            LoadState(&reference, &outputs);
+            UpdateReference(&inputs, &outputs, MAX_INSTANCES);
+            SaveState(&reference, &outputs);
+
+            LoadState(&fused, &outputs);
+            UpdateFused(&inputs, &outputs, MAX_INSTANCES);
+            SaveState(&fused, &outputs);
+
+            if (memcmp(&reference, &fused, sizeof(State)) != 0)
+            {
+                printf("fused kernel differs from reference in regime %s at frame %d\n", regimes[r].name, frame);
+                equivalent = 0;
+                break;
+            }
+        }
+    }
+
+    return equivalent;
+}
+
+// settles the blades of a single instance at constant rotor speed and
+// collective without cyclic, and compares the coning and lag with the static
+// equilibrium of the blade model, at every step length the governor uses
+static int CheckBladeEquilibrium(void)
+{
+    static const float tacrads[] = {0.0f, 10.0f, 50.0f};
+    int settled = 1;
+
+    for (size_t l = 0; l < GOVERNOR_LEVEL_COUNT * sizeof(tacrads) / sizeof(tacrads[0]); l++)
+    {
+        size_t t = l % (sizeof(tacrads) / sizeof(tacrads[0]));
+        SimInputs snapshot;
+        FillHover(&snapshot, 0.0f);
+        snapshot.pointTacrad[0] = tacrads[t];
+        snapshot.yolkPitchRatio = 0.0f;
+        snapshot.yolkRollRatio = 0.0f;
+        snapshot.governorLevel = (int32_t) (l / (sizeof(tacrads) / sizeof(tacrads[0])));
+
+        InstanceInputs inputs;
+        InstanceOutputs outputs;
+        SetInstanceInputs(&inputs, 0, &snapshot);
+        ResetInstances();
+
+        for (int frame = 0; frame < 60 * 30; frame++)
+            UpdateRotor(&inputs, &outputs, 1);
+
+        double tacradSquared = (double) tacrads[t] * tacrads[t];
+        double pitch = snapshot.pointPitchDeg * M_PI / 180.0;
+        double flap = (BLADE_LOCK_NUMBER / 8.0 * tacradSquared * pitch - BLADE_DROOP_ACCELERATION) / (BLADE_FLAP_FREQUENCY * BLADE_FLAP_FREQUENCY * tacradSquared + BLADE_FLAP_STIFFNESS);
+        flap = flap < BLADE_DROOP_STOP ? BLADE_DROOP_STOP : flap;
+        double lag = (BLADE_PROFILE_DRAG + BLADE_INDUCED_DRAG * pitch) * tacradSquared / (BLADE_LAG_FREQUENCY * BLADE_LAG_FREQUENCY * tacradSquared + BLADE_LAG_STIFFNESS);
+
+        float coning = instances.channels[CHANNEL_ROTOR_BLADES_CONING][0];
+        float lag0 = instances.channels[CHANNEL_ROTOR_BLADES_LAG_0][0];
+        printf("blades at %.0f rad/s, governor level %d: coning %.3f deg (expected %.3f), lag %.3f deg (expected %.3f)\n", tacrads[t], snapshot.governorLevel, coning, flap * 180.0 / M_PI, lag0, lag * 180.0 / M_PI);
+
+        if (fabs(coning - flap * 180.0 / M_PI) > 1e-3 || fabs(lag0 - lag * 180.0 / M_PI) > 1e-3)
+            settled = 0;
+    }
+
+    if (!settled)
+        printf("blade dynamics do not settle to their static equilibrium\n");
+
+    return settled;
+}
+
+// opens and closes the doors of a single instance at 20 and 200 fps, flipping
+// the request at the same times, and compares their positions at every frame
+// both rates share
+static int CheckDoorFrameRates(void)
+{
+    static const int rates[] = {20, 200};
+    static float positions[2][20 * 16];
+    double maxError = 0.0;
+
+    for (int r = 0; r < 2; r++)
+    {
+        InstanceInputs inputs;
+        memset(&inputs, 0, sizeof(inputs));
+        inputs.tuning = defaultTuning;
+        ResetInstances();
+
+        int stride = rates[r] / rates[0];
+        for (int frame = 0; frame < rates[r] * 16; frame++)
+        {
+            // open for six seconds, closed for two, then flipped while closing
+            // and again while bouncing back
+            int tick = frame / stride;
+            inputs.flaprqst[0] = tick < 120 || (tick >= 160 && tick < 181) || tick >= 203 ? 1.0f : 0.0f;
+            UpdateDoors(&inputs, 1.0f / rates[r], 1);
+
+            if ((frame + 1) % stride == 0)
+                positions[r][tick] = GetChannel(CHANNEL_DOORS_LEFT_POSITION, 0);
+        }
+    }
+
+    for (int tick = 0; tick < 20 * 16; tick++)
+    {
+        double error = fabs(positions[0][tick] - positions[1][tick]);
+        maxError = error > maxError ? error : maxError;
+    }
+
+    printf("doors at 20 and 200 fps differ by at most %.2g\n", maxError);
+    if (maxError > 1e-5)
+    {
+        printf("door positions depend on the frame rate\n");
+        return 0;
+    }
+
+    return 1;
+}
+
+// moves the camera of a single hovering instance out past the frozen blade
+// pitch and back in small steps, and checks that the pitch of the first blade
+// never changes by more than the cyclic fading out over one step
+static int CheckBladePitchLod(void)
+{
+    const float step = 0.25f;
+    const LodDescriptor *lod = &lodDescriptors[LOD_BLADE_PITCH];
+    float farthest = lod->frozenDistance * (1.0f + LOD_HYSTERESIS) + 10.0f;
+
+    SimInputs snapshot;
+    FillHover(&snapshot, 0.0f);
+    snapshot.yolkPitchRatio = 1.0f;
+    snapshot.yolkRollRatio = 1.0f;
+
+    InstanceInputs inputs;
+    ResetInstances();
+
+    double cyclic = hypot(snapshot.acfCyclicAiln, snapshot.acfCyclicElev);
+    double bound = cyclic * step / (lod->frozenDistance * (1.0f - LOD_HYSTERESIS) - lod->reducedDistance) + 1e-4;
+    double maxChange = 0.0;
+    float previous = 0.0f;
+    int steps = (int) (farthest / step), froze = 0;
+
+    for (int i = 0; i <= 2 * steps; i++)
+    {
+        snapshot.cameraDistance = (i <= steps ? i : 2 * steps - i) * step;
+        UpdateLod(&snapshot);
+        froze |= snapshot.lodTiers[LOD_BLADE_PITCH] == LOD_FROZEN;
+        SetInstanceInputs(&inputs, 0, &snapshot);
+        UpdateBladePitch(&inputs, 1);
+
+        float pitch = instances.channels[CHANNEL_ROTOR_BLADES_PITCH_0][0];
+        if (i > 0 && fabs(pitch - previous) > maxChange)
+            maxChange = fabs(pitch - previous);
+        previous = pitch;
+    }
+
+    printf("blade pitch changes by at most %.3g deg per %.2g m of camera distance (bound %.3g)\n", maxChange, step, bound);
+    if (!froze || maxChange > bound)
+    {
+        printf("blade pitch jumps with its level of detail\n");
+        return 0;
+    }
+
+    return 1;
+}
+
+// checks the fast math functions against double precision libm, visiting
+// every float of the documented domain when exhaustive is set and every
+// 251st float otherwise
+static int CheckMathAccuracy(int exhaustive)
+{
+    const uint32_t stride = exhaustive ? 1 : 251;
+    int accurate = 1;
+
+    float low = 1.0f / 4096.0f, high = 8192.0f;
+    uint32_t lowBits, highBits;
+    memcpy(&lowBits, &low, sizeof(float));
+    memcpy(&highBits, &high, sizeof(float));
+
+    double maxSinError = 0.0, maxCosError = 0.0;
+    for (uint32_t bits = lowBits; bits <= highBits; bits += stride)
+    {
+        for (int sign = 0; sign < 2; sign++)
+        {
+            float x;
+            memcpy(&x, &bits, sizeof(float));
+            if (sign)
+                x = -x;
+
+            float s, c;
+            FastSinCos(x, &s, &c);
+
+            double sinError = fabs(s - sin((double) x));
+            double cosError = fabs(c - cos((double) x));
+            if (sinError > maxSinError)
+                maxSinError = sinError;
+            if (cosError > maxCosError)
+                maxCosError = cosError;
+        }
+    }
+
+    // the polynomial only ever sees the ratio of the smaller to the larger
+    // magnitude, so every ratio in [0, 1] is visited in all eight octants
+    float one = 1.0f;
+    uint32_t oneBits;
+    memcpy(&oneBits, &one, sizeof(float));
+
+    double maxAtan2Error = 0.0;
+    for (uint32_t bits = 0; bits <= oneBits; bits += stride)
+    {
+        float a;
+        memcpy(&a, &bits, sizeof(float));
+
+        const float ys[8] = {a, 1.0f, 1.0f, a, -a, -1.0f, -1.0f, -a};
+        const float xs[8] = {1.0f, a, -a, -1.0f, -1.0f, -a, a, 1.0f};
+        for (int octant = 0; octant < 8; octant++)
+        {
+            double error = fabs(FastAtan2(ys[octant], xs[octant]) - atan2((double) ys[octant], (double) xs[octant]));
+            if (error > maxAtan2Error)
+                maxAtan2Error = error;
+        }
+    }
+
+    printf("FastSinCos max error sin %.3g cos %.3g (bound 1e-7)\n", maxSinError, maxCosError);
+    printf("FastAtan2 max error %.3g rad (bound 2e-6)\n", maxAtan2Error);
+
+    if (maxSinError > 1.0e-7 || maxCosError > 1.0e-7 || maxAtan2Error > 2.0e-6)
+    {
+        printf("fast math exceeds its documented error bounds\n");
+        accurate = 0;
+    }
+
+    return accurate;
+}
+
+static volatile float mathSink;
+
+// times the fast math functions against their libm counterparts
+static void BenchMath(void)
+{
+    const int calls = 1 << 22;
+    float accumulator = 0.0f;
+
+    double start = Now();
+    for (int i = 0; i < calls; i++)
+    {
+        float s, c;
+        FastSinCos(i * 0.001f, &s, &c);
+        accumulator += s + c;
+    }
+    double fastSinCos = (Now() - start) * 1e9 / calls;
+
+    start = Now();
+    for (int i = 0; i < calls; i++)
+        accumulator += (float) (sin(i * 0.001) + cos(i * 0.001));
+    double libmSinCos = (Now() - start) * 1e9 / calls;
+
+    start = Now();
+    for (int i = 0; i < calls; i++)
+        accumulator += FastAtan2(i * 0.001f - 2000.0f, 1000.0f - i * 0.0007f);
+    double fastAtan2 = (Now() - start) * 1e9 / calls;
+
+    start = Now();
+    for (int i = 0; i < calls; i++)
+        accumulator += (float) atan2(i * 0.001 - 2000.0, 1000.0 - i * 0.0007);
+    double libmAtan2 = (Now() - start) * 1e9 / calls;
+
+    mathSink = accumulator;
+
+    printf("sincos: fast %.2f ns, libm %.2f ns\n", fastSinCos, libmSinCos);
+    printf("atan2: fast %.2f ns, libm %.2f ns\n", fastAtan2, libmAtan2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter = argc > 1 ? argv[1] : NULL;
+
+    LoadTracks(NULL);
+
+    if (filter != NULL && strcmp(filter, "accuracy") == 0)
+        return CheckMathAccuracy(1) ? 0 : 1;
+
+    int instructionCounter = OpenInstructionCounter();
+    if (instructionCounter < 0)
+        fprintf(stderr, "instruction counter unavailable, reporting timings only\n");
+
+    printf("%-10s %-18s %10s %12s %12s\n", "subsystem", "regime", "ns/frame", "var (ns^2)", "instr/call");
+
+    for (size_t s = 0; s < sizeof(subsystems) / sizeof(subsystems[0]); s++)
+    {
+        if (filter != NULL && strcmp(filter, subsystems[s].name) != 0)
+            continue;
+
+        for (size_t r = 0; r < sizeof(regimes) / sizeof(regimes[0]); r++)
+            RunBenchmark(&subsystems[s], &regimes[r], instructionCounter);
+    }
+
+    if (instructionCounter >= 0)
+        close(instructionCounter);
+
+    if (!CheckFusedEquivalence())
+        return 1;
+
+    printf("fused kernel is bit-for-bit equivalent to reference\n");
+
+    if (filter == NULL || strcmp(filter, "instances") == 0)
+        BenchInstances();
+
+    if (filter == NULL || strcmp(filter, "tracks") == 0)
+        BenchTracks();
+
+    if (!CheckBladeEquilibrium())
+        return 1;
+
+    if (!CheckDoorFrameRates())
+        return 1;
+
+    if (!CheckBladePitchLod())
+        return 1;
+
+    BenchMath();
+
+    if (!CheckMathAccuracy(0))
+        return 1;
+
+    return 0;
+}
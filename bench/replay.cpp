@@ -0,0 +1,273 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// replays telemetry files recorded by the plugin through its update functions
+// and checks that every frame reproduces the recorded results bit for bit
+//
+// the state is taken from the first record and from the first record after
+// every gap of dropped records, every other frame runs the stages recorded
+// for it with the recorded inputs and time steps; the time spent in the
+// update functions is reported, so captures double as benchmarks
+
+#include "../hughes_500d.cpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+// define replay parameters
+#define MAX_REPORTED_MISMATCHES 5
+
+struct Capture
+{
+    const TelemetryFileHeader *header;
+    const TelemetryRecord *records;
+    size_t recordCount;
+    size_t mappedSize;
+};
+
+struct ReplayResult
+{
+    size_t frames;
+    size_t mismatches;
+    size_t resyncs;
+    double seconds;
+};
+
+static double Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// maps a telemetry file and checks that it was recorded by this build
+static int OpenCapture(const char *path, Capture *capture)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(TelemetryFileHeader))
+    {
+        fprintf(stderr, "%s is not a telemetry file\n", path);
+        close(fd);
+        return 0;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        fprintf(stderr, "cannot map %s\n", path);
+        return 0;
+    }
+
+    const TelemetryFileHeader *header = (const TelemetryFileHeader *) data;
+    if (strcmp(header->magic, TELEMETRY_MAGIC) != 0 || header->version != TELEMETRY_VERSION || header->headerSize != sizeof(TelemetryFileHeader) || header->recordSize != sizeof(TelemetryRecord) || header->channelCount != CHANNEL_COUNT)
+    {
+        fprintf(stderr, "%s was recorded by an incompatible build\n", path);
+        munmap(data, st.st_size);
+        return 0;
+    }
+
+    if (header->trackChecksum != TrackChecksum(&trackTable))
+    {
+        fprintf(stderr, "%s was recorded with other animation tracks, pass them with -a\n", path);
+        munmap(data, st.st_size);
+        return 0;
+    }
+
+    capture->header = header;
+    capture->records = (const TelemetryRecord *) ((const char *) data + header->headerSize);
+    capture->recordCount = (st.st_size - header->headerSize) / header->recordSize;
+    capture->mappedSize = st.st_size;
+
+    // a file that was not closed properly ends with zeroed records
+    while (capture->recordCount > 0 && capture->records[capture->recordCount - 1].sequence == 0)
+        capture->recordCount--;
+
+    return 1;
+}
+
+static void CloseCapture(Capture *capture)
+{
+    munmap((void *) capture->header, capture->mappedSize);
+}
+
+// sets the state of the user's aircraft to the state at the end of a recorded
+// frame, the recording only covers instance 0
+static void LoadState(const TelemetryRecord *record)
+{
+    for (int i = 0; i < CHANNEL_COUNT; i++)
+        instances.channels[i][0] = record->channels[i];
+    instances.doorTime[0] = record->doorTime;
+    instances.doorDuration[0] = trackTable.tracks[doorTracks[record->doorOpen]].endTime;
+    instances.doorOpen[0] = record->doorOpen;
+    instances.doorStale[0] = 0;
+    instances.bladeDynamics[0] = record->bladeDynamics;
+    instanceOutputs.cyclicElevDiscTilt[0] = record->outputs.cyclicElevDiscTilt;
+    instanceOutputs.cyclicAilnDiscTilt[0] = record->outputs.cyclicAilnDiscTilt;
+    instanceOutputs.pDot[0] = record->outputs.pDot;
+    instanceOutputs.qDot[0] = record->outputs.qDot;
+}
+
+// returns whether the state of the user's aircraft matches a recorded frame
+static int MatchesState(const TelemetryRecord *record)
+{
+    SimOutputs outputs;
+    GetInstanceOutputs(&instanceOutputs, 0, &outputs);
+
+    for (int i = 0; i < CHANNEL_COUNT; i++)
+    {
+        float channel = GetChannel(i, 0);
+        if (memcmp(&channel, &record->channels[i], sizeof(float)) != 0)
+            return 0;
+    }
+
+    if (memcmp(&instances.doorTime[0], &record->doorTime, sizeof(float)) != 0 || instances.doorOpen[0] != record->doorOpen)
+        return 0;
+
+    return memcmp(&outputs, &record->outputs, sizeof(SimOutputs)) == 0 && memcmp(&instances.bladeDynamics[0], &record->bladeDynamics, sizeof(BladeDynamics)) == 0;
+}
+
+// runs the stages recorded for a frame, in the order the plugin runs them
+static void ReplayFrame(const Capture *capture, const TelemetryRecord *record)
+{
+    InstanceInputs *inputs = &instanceInputs;
+
+    if (record->stages & (1u << PROFILE_SHUDDER))
+    {
+        SetInstanceInputs(inputs, 0, &record->shudderInputs);
+        UpdateTransitionalShudder(inputs, &instanceOutputs, 1);
+    }
+
+    SetInstanceInputs(inputs, 0, &record->inputs);
+    RunStages(inputs, &instanceOutputs, record->stages, record->deltaTimes, capture->header->referenceUpdate, 1);
+}
+
+static void Replay(const Capture *capture, const char *path, ReplayResult *result)
+{
+    double seconds = 0.0;
+
+    ResetInstances();
+    LoadState(&capture->records[0]);
+
+    for (size_t i = 1; i < capture->recordCount; i++)
+    {
+        const TelemetryRecord *record = &capture->records[i];
+
+        if (record->sequence != capture->records[i - 1].sequence + 1)
+        {
+            LoadState(record);
+            result->resyncs++;
+            continue;
+        }
+
+        double start = Now();
+        ReplayFrame(capture, record);
+        seconds += Now() - start;
+        result->frames++;
+
+        if (!MatchesState(record))
+        {
+            if (result->mismatches++ < MAX_REPORTED_MISMATCHES)
+                printf("%s: frame %u differs from the recording\n", path, record->sequence);
+
+            // continue from the recorded state so that one difference is
+            // reported once instead of for every following frame
+            LoadState(record);
+        }
+    }
+
+    result->seconds += seconds;
+}
+
+static void Usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-n repeats] [-a tracks.txt] capture.bin...\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    int repeats = 1, files = 0;
+    ReplayResult total;
+    memset(&total, 0, sizeof(total));
+    LoadTracks(NULL);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            repeats = atoi(argv[++i]);
+            continue;
+        }
+        else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc)
+        {
+            LoadTracks(argv[++i]);
+            continue;
+        }
+        else if (argv[i][0] == '-' || repeats <= 0)
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+
+        Capture capture;
+        if (!OpenCapture(argv[i], &capture))
+            return 1;
+
+        if (capture.recordCount < 2)
+        {
+            printf("%s: nothing to replay\n", argv[i]);
+            CloseCapture(&capture);
+            continue;
+        }
+
+        ReplayResult result;
+        memset(&result, 0, sizeof(result));
+        for (int r = 0; r < repeats; r++)
+            Replay(&capture, argv[i], &result);
+
+        printf("%s: %zu frames, %zu mismatched, %zu resyncs, %.1f ns/frame\n", argv[i], result.frames, result.mismatches, result.resyncs, result.seconds * 1e9 / result.frames);
+
+        total.frames += result.frames;
+        total.mismatches += result.mismatches;
+        total.seconds += result.seconds;
+        files++;
+
+        CloseCapture(&capture);
+    }
+
+    if (files == 0)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    if (total.mismatches > 0)
+        printf("replay differs from the recording in %zu of %zu frames\n", total.mismatches, total.frames);
+    else
+        printf("replay is bit-for-bit identical to the recording\n");
+
+    return total.mismatches > 0;
+}
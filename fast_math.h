@@ -0,0 +1,148 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef FAST_MATH_H
+#define FAST_MATH_H
+
+// float-only trigonometry for the animation paths
+//
+// none of the animated values needs more than about 1e-4 rad of accuracy, so
+// these replace the double precision libm calls with short polynomials
+//
+// maximum absolute errors against double precision libm, as checked over
+// every float of the stated domain by "build/bench/bench accuracy":
+//
+//   FastSinCos  2^-12 <= |x| <= 8192     1.0e-7
+//   FastAtan2   any finite x and y       2.0e-6 rad
+//
+// below 2^-12 the polynomials return x and 1 exactly, like libm
+
+#include <math.h>
+
+// define to 0 to route the animation math through libm instead
+#ifndef FAST_MATH
+#define FAST_MATH 1
+#endif
+
+// sine and cosine of x in radians
+// x is reduced to [-pi/4, pi/4] by the nearest multiple of pi/2, using a three
+// part pi/2 so that the reduction stays exact for the supported domain, then
+// both values are evaluated with the cephes single precision polynomials
+inline static void FastSinCos(float x, float *outSin, float *outCos)
+{
+    const float twoOverPi = 0.636619772367581343f;
+    const float piOverTwo1 = 1.5703125f;
+    const float piOverTwo2 = 4.837512969970703125e-4f;
+    const float piOverTwo3 = 7.54978995489188216e-8f;
+
+    float k = nearbyintf(x * twoOverPi);
+    float r = ((x - k * piOverTwo1) - k * piOverTwo2) - k * piOverTwo3;
+    float z = r * r;
+
+    float s = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * r + r;
+    float c = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z - 0.5f * z + 1.0f;
+
+    // the quadrant swaps and negates the results, written as selects so that
+    // loops over FastSinCos can be vectorized
+    int quadrant = (int) k & 3;
+    float sinQuadrant = quadrant & 1 ? c : s;
+    float cosQuadrant = quadrant & 1 ? s : c;
+
+    *outSin = quadrant & 2 ? -sinQuadrant : sinQuadrant;
+    *outCos = (quadrant + 1) & 2 ? -cosQuadrant : cosQuadrant;
+}
+
+inline static float FastSin(float x)
+{
+    float s, c;
+    FastSinCos(x, &s, &c);
+
+    return s;
+}
+
+// four quadrant arc tangent of y / x in radians
+// the ratio of the smaller to the larger magnitude is fed into an odd minimax
+// polynomial for atan on [0, 1], the result is then mirrored into the right
+// octant, keeping the sign of a zero y like libm; atan2(0, 0) returns 0
+inline static float FastAtan2(float y, float x)
+{
+    const float piOverTwo = 1.57079632679489662f;
+    const float pi = 3.14159265358979324f;
+
+    float absX = fabsf(x);
+    float absY = fabsf(y);
+    float maxXY = absX > absY ? absX : absY;
+    float minXY = absX > absY ? absY : absX;
+
+    if (maxXY == 0.0f)
+        return 0.0f;
+
+    float a = minXY / maxXY;
+    float s = a * a;
+    float r = a * (0.99997726f + s * (-0.33262347f + s * (0.19354346f + s * (-0.11643287f + s * (0.05265332f + s * -0.01172120f)))));
+
+    if (absY > absX)
+        r = piOverTwo - r;
+    if (x < 0.0f)
+        r = pi - r;
+    if (signbit(y))
+        r = -r;
+
+    return r;
+}
+
+// wraps an angle in degrees into [-180, 180]
+inline static float WrapDegrees(float degrees)
+{
+    return degrees - 360.0f * nearbyintf(degrees * (1.0f / 360.0f));
+}
+
+// the functions used by the animation code, selected at build time
+#if FAST_MATH
+inline static void MathSinCos(float x, float *outSin, float *outCos)
+{
+    FastSinCos(x, outSin, outCos);
+}
+
+inline static float MathSin(float x)
+{
+    return FastSin(x);
+}
+
+inline static float MathAtan2(float y, float x)
+{
+    return FastAtan2(y, x);
+}
+#else
+inline static void MathSinCos(float x, float *outSin, float *outCos)
+{
+    *outSin = sinf(x);
+    *outCos = cosf(x);
+}
+
+inline static float MathSin(float x)
+{
+    return sinf(x);
+}
+
+inline static float MathAtan2(float y, float x)
+{
+    return atan2f(y, x);
+}
+#endif
+
+#endif
@@ -0,0 +1,924 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// minimal implementation of the parts of the XPLM API that the plugin uses,
+// so that lin.xpl can be loaded and driven without X-Plane
+//
+// windows, menus and text only keep the state the plugin can query back,
+// nothing is ever drawn
+
+#include "XPLMStub.h"
+#include "XPLMDisplay.h"
+#include "XPLMGraphics.h"
+#include "XPLMMenus.h"
+#include "XPLMPlugin.h"
+#include "XPLMProcessing.h"
+#include "XPLMUtilities.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// define limits
+#define MAX_DATAREFS 256
+#define MAX_FLIGHT_LOOPS 64
+#define MAX_NAME_LENGTH 128
+#define MAX_WINDOWS 16
+#define MAX_MENUS 16
+#define MAX_MENU_ITEMS 32
+#define MAX_SHARE_NOTIFICATIONS 8
+
+// define the simulated screen and font
+#define SCREEN_WIDTH 1920
+#define SCREEN_HEIGHT 1080
+#define CHAR_WIDTH 8
+#define CHAR_HEIGHT 12
+
+#define SCALAR_TYPES (xplmType_Int | xplmType_Float | xplmType_Double)
+
+struct DataRefEntry
+{
+    int used;
+    int owned;
+    char name[MAX_NAME_LENGTH];
+    XPLMDataTypeID type;
+    int writable;
+
+    // storage of host owned datarefs
+    int count;
+    double scalar;
+    float floats[XPLM_STUB_MAX_ARRAY];
+    int ints[XPLM_STUB_MAX_ARRAY];
+
+    // accessors of plugin owned datarefs
+    XPLMGetDatai_f readInt;
+    XPLMSetDatai_f writeInt;
+    XPLMGetDataf_f readFloat;
+    XPLMSetDataf_f writeFloat;
+    XPLMGetDatad_f readDouble;
+    XPLMSetDatad_f writeDouble;
+    XPLMGetDatavi_f readIntArray;
+    XPLMSetDatavi_f writeIntArray;
+    XPLMGetDatavf_f readFloatArray;
+    XPLMSetDatavf_f writeFloatArray;
+    XPLMGetDatab_f readData;
+    XPLMSetDatab_f writeData;
+    void *readRefcon;
+    void *writeRefcon;
+
+    // notifications of shared datarefs, called whenever the value is set
+    int shared;
+    XPLMDataChanged_f notifications[MAX_SHARE_NOTIFICATIONS];
+    void *notificationRefcons[MAX_SHARE_NOTIFICATIONS];
+};
+
+struct FlightLoopEntry
+{
+    int used;
+    int legacy;
+    XPLMFlightLoopPhaseType phase;
+    XPLMFlightLoop_f callback;
+    void *refcon;
+
+    int scheduled;
+    int byFrames;
+    int nextCycle;
+    float nextTime;
+    float lastCallTime;
+};
+
+struct WindowEntry
+{
+    int used;
+    int left;
+    int top;
+    int right;
+    int bottom;
+    int visible;
+    XPLMDrawWindow_f draw;
+    void *refcon;
+};
+
+struct MenuItemEntry
+{
+    char name[MAX_NAME_LENGTH];
+    void *itemRef;
+    XPLMMenuCheck check;
+};
+
+struct MenuEntry
+{
+    int used;
+    XPLMMenuHandler_f handler;
+    void *menuRef;
+    int itemCount;
+    MenuItemEntry items[MAX_MENU_ITEMS];
+};
+
+static DataRefEntry dataRefs[MAX_DATAREFS];
+static FlightLoopEntry flightLoops[MAX_FLIGHT_LOOPS];
+static WindowEntry windows[MAX_WINDOWS];
+static MenuEntry menus[MAX_MENUS];
+
+// the plugins menu that every plugin menu hangs off
+static MenuEntry pluginsMenu = {1, NULL, NULL, 0};
+
+static float elapsedTime = 0.0f, lastFrameTime = 0.0f;
+static int cycleNumber = 0;
+
+static char systemPath[512] = "./";
+static char pluginPath[512] = "";
+
+static XPLMCameraPosition_t cameraPosition = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+
+static XPLMStubFlightModel_f flightModel = NULL;
+static void *flightModelRefcon = NULL;
+
+static DataRefEntry *AllocateDataRef(const char *inDataName)
+{
+    for (int i = 0; i < MAX_DATAREFS; i++)
+    {
+        if (!dataRefs[i].used)
+        {
+            DataRefEntry *entry = &dataRefs[i];
+            memset(entry, 0, sizeof(DataRefEntry));
+            entry->used = 1;
+            strncpy(entry->name, inDataName, MAX_NAME_LENGTH - 1);
+
+            return entry;
+        }
+    }
+
+    fprintf(stderr, "XPLMStub: dataref table full, cannot add %s\n", inDataName);
+
+    return NULL;
+}
+
+static int CopyOut(void *outValues, const void *inValues, int inElementSize, int inCount, int inOffset, int inMax)
+{
+    if (outValues == NULL)
+        return inCount;
+
+    int n = inCount - inOffset;
+    if (n > inMax)
+        n = inMax;
+    if (n <= 0)
+        return 0;
+
+    memcpy(outValues, (const char *) inValues + inOffset * inElementSize, n * inElementSize);
+
+    return n;
+}
+
+static void CopyIn(void *outValues, const void *inValues, int inElementSize, int inCount, int inOffset, int inLength)
+{
+    int n = inCount - inOffset;
+    if (n > inLength)
+        n = inLength;
+    if (n <= 0)
+        return;
+
+    memcpy((char *) outValues + inOffset * inElementSize, inValues, n * inElementSize);
+}
+
+// calls the notifications of a shared dataref after its value was set
+static void NotifyDataRef(DataRefEntry *entry)
+{
+    for (int i = 0; i < MAX_SHARE_NOTIFICATIONS; i++)
+    {
+        if (entry->notifications[i] != NULL)
+            entry->notifications[i](entry->notificationRefcons[i]);
+    }
+}
+
+XPLM_API XPLMDataRef XPLMStubCreateDataRef(const char *inDataName, XPLMDataTypeID inDataType, int inCount)
+{
+    DataRefEntry *entry = AllocateDataRef(inDataName);
+    if (entry == NULL)
+        return NULL;
+
+    entry->owned = 1;
+    entry->writable = 1;
+    entry->type = inDataType;
+    if (inDataType & SCALAR_TYPES)
+        entry->type |= SCALAR_TYPES;
+    entry->count = inCount > XPLM_STUB_MAX_ARRAY ? XPLM_STUB_MAX_ARRAY : inCount;
+
+    return entry;
+}
+
+XPLM_API XPLMDataRef XPLMFindDataRef(const char *inDataRefName)
+{
+    for (int i = 0; i < MAX_DATAREFS; i++)
+    {
+        if (dataRefs[i].used && strcmp(dataRefs[i].name, inDataRefName) == 0)
+            return &dataRefs[i];
+    }
+
+    return NULL;
+}
+
+XPLM_API int XPLMCanWriteDataRef(XPLMDataRef inDataRef)
+{
+    return inDataRef != NULL && ((DataRefEntry *) inDataRef)->writable;
+}
+
+XPLM_API int XPLMIsDataRefGood(XPLMDataRef inDataRef)
+{
+    return inDataRef != NULL && ((DataRefEntry *) inDataRef)->used;
+}
+
+XPLM_API XPLMDataTypeID XPLMGetDataRefTypes(XPLMDataRef inDataRef)
+{
+    return inDataRef != NULL ? ((DataRefEntry *) inDataRef)->type : xplmType_Unknown;
+}
+
+XPLM_API int XPLMGetDatai(XPLMDataRef inDataRef)
+{
+    DataRefEntry *entry = (DataRefEntry *) inDataRef;
+    if (entry == NULL || !(entry->type & xplmType_Int))
+        return 0;
+
+    if (entry->owned)
+        return (int) entry->scalar;
+
+    return entry->readInt != NULL ? entry->readInt(entry->readRefcon) : 0;
+}
+
+XPLM_API void XPLMSetDatai(XPLMDataRef inDataRef, int inValue)
+{
+    DataRefEntry *entry = (DataRefEntry *) inDataRef;
+    if (entry == NULL || !entry->writable || !(entry->type & xplmType_Int))
+        return;
+
+    if (entry->owned)
+    {
+        entry->scalar = inValue;
+        NotifyDataRef(entry);
+    }
+    else if (entry->writeInt != NULL)
+        entry->writeInt(entry->writeRefcon, inValue);
+}
+
+XPLM_API float XPLMGetDataf(XPLMDataRef inDataRef)
+{
+    DataRefEntry *entry = (DataRefEntry *) inDataRef;
+    if (entry == NULL || !(entry->type & xplmType_Float))
+        return 0.0f;
+
+    if (entry->owned)
+        return (float) entry->scalar;
+
+    return entry->readFloat != NULL ? entry->readFloat(entry->readRefcon) : 0.0f;
+}
+
+XPLM_API void XPLMSetDataf(XPLMDataRef inDataRef, float inValue)
+{
+    DataRefEntry *entry = (DataRefEntry *) inDataRef;
+    if (entry == NULL || !entry->writable || !(entry->type & xplmType_Float))
+        return;
+
+    if (entry->owned)
+    {
+        entry->scalar = inValue;
+        NotifyDataRef(entry);
+    }
+    else if (entry->writeFloat != NULL)
+        entry->writeFloat(entry->writeRefcon, inValue);
+}
+
+XPLM_API double XPLMGetDatad(XPLMDataRef inDataRef)
+{
+    DataRefEntry *entry = (DataRefEntry *) inDataRef;
+    if (entry == NULL || !(entry->type & xplmType_Double))
+        return 0.0;
+
+    if (entry->owned)
+        return entry->scalar;
+
+    return entry->readDouble != NULL ? entry->readDouble(entry->readRefcon) : 0.0;
+}
+
+XPLM_API void XPLMSetDatad(XPLMDataRef inDataRef, double inValue)
+{
+    DataRefEntry *entry = (DataRefEntry *) inDataRef;
+    if (entry == NULL || !entry->writable || !(entry->type & xplmType_Double))
+        return;
+
+    if (entry->owned)
+    {
+        entry->scalar = inValue;
+        NotifyDataRef(entry);
+    }
+    else if (entry->writeDouble != NULL)
+        entry->writeDouble(entry->writeRefcon, inValue);
+}
+
+XPLM_API int XPLMGetDatavi(XPLMDataRef inDataRef, int *outValues, int inOffset, int inMax)
+{
+    DataRefEntry *entry = (DataRefEntry *) inDataRef;
+    if (entry == NULL || !(entry->type & xplmType_IntArray))
+        return 0;
+
+    if (entry->owned)
+        return CopyOut(outValues, entry->ints, sizeof(int), entry->count, inOffset, inMax);
+
+    return entry->readIntArray != NULL ? entry->readIntArray(entry->readRefcon, outValues, inOffset, inMax) : 0;
+}
+
+XPLM_API void XPLMSetDatavi(XPLMDataRef inDataRef, int *inValues, int inoffset, int inCount)
+{
+    DataRefEntry *entry = (DataRefEntry *) inDataRef;
+    if (entry == NULL || !entry->writable || !(entry->type & xplmType_IntArray))
+        return;
+
+    if (entry->owned)
+    {
+        CopyIn(entry->ints, inValues, sizeof(int), entry->count, inoffset, inCount);
+        NotifyDataRef(entry);
+    }
+    else if (entry->writeIntArray != NULL)
+        entry->writeIntArray(entry->writeRefcon, inValues, inoffset, inCount);
+}
+
+XPLM_API int XPLMGetDatavf(XPLMDataRef inDataRef, float *outValues, int inOffset, int inMax)
+{
+    DataRefEntry *entry = (DataRefEntry *) inDataRef;
+    if (entry == NULL || !(entry->type & xplmType_FloatArray))
+        return 0;
+
+    if (entry->owned)
+        return CopyOut(outValues, entry->floats, sizeof(float), entry->count, inOffset, inMax);
+
+    return entry->readFloatArray != NULL ? entry->readFloatArray(entry->readRefcon, outValues, inOffset, inMax) : 0;
+}
+
+XPLM_API void XPLMSetDatavf(XPLMDataRef inDataRef, float *inValues, int inoffset, int inCount)
+{
+    DataRefEntry *entry = (DataRefEntry *) inDataRef;
+    if (entry == NULL || !entry->writable || !(entry->type & xplmType_FloatArray))
+        return;
+
+    if (entry->owned)
+    {
+        CopyIn(entry->floats, inValues, sizeof(float), entry->count, inoffset, inCount);
+        NotifyDataRef(entry);
+    }
+    else if (entry->writeFloatArray != NULL)
+        entry->writeFloatArray(entry->writeRefcon, inValues, inoffset, inCount);
+}
+
+XPLM_API int XPLMGetDatab(XPLMDataRef inDataRef, void *outValue, int inOffset, int inMaxBytes)
+{
+    DataRefEntry *entry = (DataRefEntry *) inDataRef;
+    if (entry == NULL || entry->owned || entry->readData == NULL)
+        return 0;
+
+    return entry->readData(entry->readRefcon, outValue, inOffset, inMaxBytes);
+}
+
+XPLM_API void XPLMSetDatab(XPLMDataRef inDataRef, void *inValue, int inOffset, int inLength)
+{
+    DataRefEntry *entry = (DataRefEntry *) inDataRef;
+    if (entry == NULL || entry->owned || !entry->writable || entry->writeData == NULL)
+        return;
+
+    entry->writeData(entry->writeRefcon, inValue, inOffset, inLength);
+}
+
+XPLM_API XPLMDataRef XPLMRegisterDataAccessor(const char *inDataName, XPLMDataTypeID inDataType, int inIsWritable, XPLMGetDatai_f inReadInt, XPLMSetDatai_f inWriteInt, XPLMGetDataf_f inReadFloat, XPLMSetDataf_f inWriteFloat, XPLMGetDatad_f inReadDouble, XPLMSetDatad_f inWriteDouble, XPLMGetDatavi_f inReadIntArray, XPLMSetDatavi_f inWriteIntArray, XPLMGetDatavf_f inReadFloatArray, XPLMSetDatavf_f inWriteFloatArray, XPLMGetDatab_f inReadData, XPLMSetDatab_f inWriteData, void *inReadRefcon, void *inWriteRefcon)
+{
+    if (XPLMFindDataRef(inDataName) != NULL)
+    {
+        fprintf(stderr, "XPLMStub: dataref %s registered twice\n", inDataName);
+        return NULL;
+    }
+
+    DataRefEntry *entry = AllocateDataRef(inDataName);
+    if (entry == NULL)
+        return NULL;
+
+    entry->type = inDataType;
+    entry->writable = inIsWritable;
+    entry->readInt = inReadInt;
+    entry->writeInt = inWriteInt;
+    entry->readFloat = inReadFloat;
+    entry->writeFloat = inWriteFloat;
+    entry->readDouble = inReadDouble;
+    entry->writeDouble = inWriteDouble;
+    entry->readIntArray = inReadIntArray;
+    entry->writeIntArray = inWriteIntArray;
+    entry->readFloatArray = inReadFloatArray;
+    entry->writeFloatArray = inWriteFloatArray;
+    entry->readData = inReadData;
+    entry->writeData = inWriteData;
+    entry->readRefcon = inReadRefcon;
+    entry->writeRefcon = inWriteRefcon;
+
+    return entry;
+}
+
+XPLM_API void XPLMUnregisterDataAccessor(XPLMDataRef inDataRef)
+{
+    DataRefEntry *entry = (DataRefEntry *) inDataRef;
+    if (entry != NULL && !entry->owned)
+        entry->used = 0;
+}
+
+XPLM_API int XPLMShareData(const char *inDataName, XPLMDataTypeID inDataType, XPLMDataChanged_f inNotificationFunc, void *inNotificationRefcon)
+{
+    DataRefEntry *entry = (DataRefEntry *) XPLMFindDataRef(inDataName);
+    if (entry == NULL)
+    {
+        entry = (DataRefEntry *) XPLMStubCreateDataRef(inDataName, inDataType, XPLM_STUB_MAX_ARRAY);
+        if (entry == NULL)
+            return 0;
+        entry->shared = 1;
+        entry->type = inDataType;
+    }
+    else if (!entry->shared || entry->type != inDataType)
+        return 0;
+
+    if (inNotificationFunc == NULL)
+        return 1;
+
+    for (int i = 0; i < MAX_SHARE_NOTIFICATIONS; i++)
+    {
+        if (entry->notifications[i] == NULL)
+        {
+            entry->notifications[i] = inNotificationFunc;
+            entry->notificationRefcons[i] = inNotificationRefcon;
+            return 1;
+        }
+    }
+
+    fprintf(stderr, "XPLMStub: too many notifications for %s\n", inDataName);
+
+    return 1;
+}
+
+XPLM_API int XPLMUnshareData(const char *inDataName, XPLMDataTypeID inDataType, XPLMDataChanged_f inNotificationFunc, void *inNotificationRefcon)
+{
+    DataRefEntry *entry = (DataRefEntry *) XPLMFindDataRef(inDataName);
+    if (entry == NULL || !entry->shared || entry->type != inDataType)
+        return 0;
+
+    for (int i = 0; i < MAX_SHARE_NOTIFICATIONS; i++)
+    {
+        if (entry->notifications[i] == inNotificationFunc && entry->notificationRefcons[i] == inNotificationRefcon)
+        {
+            entry->notifications[i] = NULL;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void ScheduleFlightLoop(FlightLoopEntry *loop, float inInterval, float inBaseTime)
+{
+    if (inInterval == 0.0f)
+    {
+        loop->scheduled = 0;
+        return;
+    }
+
+    loop->scheduled = 1;
+
+    if (inInterval < 0.0f)
+    {
+        loop->byFrames = 1;
+        loop->nextCycle = cycleNumber + (int) ceilf(-inInterval);
+    }
+    else
+    {
+        loop->byFrames = 0;
+        loop->nextTime = inBaseTime + inInterval;
+    }
+}
+
+static FlightLoopEntry *AllocateFlightLoop(XPLMFlightLoop_f inFlightLoop, void *inRefcon)
+{
+    for (int i = 0; i < MAX_FLIGHT_LOOPS; i++)
+    {
+        if (!flightLoops[i].used)
+        {
+            FlightLoopEntry *loop = &flightLoops[i];
+            memset(loop, 0, sizeof(FlightLoopEntry));
+            loop->used = 1;
+            loop->callback = inFlightLoop;
+            loop->refcon = inRefcon;
+            loop->lastCallTime = elapsedTime;
+
+            return loop;
+        }
+    }
+
+    fprintf(stderr, "XPLMStub: flight loop table full\n");
+
+    return NULL;
+}
+
+static FlightLoopEntry *FindLegacyFlightLoop(XPLMFlightLoop_f inFlightLoop, void *inRefcon)
+{
+    for (int i = 0; i < MAX_FLIGHT_LOOPS; i++)
+    {
+        FlightLoopEntry *loop = &flightLoops[i];
+        if (loop->used && loop->legacy && loop->callback == inFlightLoop && loop->refcon == inRefcon)
+            return loop;
+    }
+
+    return NULL;
+}
+
+XPLM_API float XPLMGetElapsedTime(void)
+{
+    return elapsedTime;
+}
+
+XPLM_API int XPLMGetCycleNumber(void)
+{
+    return cycleNumber;
+}
+
+XPLM_API void XPLMRegisterFlightLoopCallback(XPLMFlightLoop_f inFlightLoop, float inInterval, void *inRefcon)
+{
+    FlightLoopEntry *loop = AllocateFlightLoop(inFlightLoop, inRefcon);
+    if (loop == NULL)
+        return;
+
+    // legacy callbacks are called at the end of the flight loop
+    loop->legacy = 1;
+    loop->phase = xplm_FlightLoop_Phase_AfterFlightModel;
+    ScheduleFlightLoop(loop, inInterval, elapsedTime);
+}
+
+XPLM_API void XPLMUnregisterFlightLoopCallback(XPLMFlightLoop_f inFlightLoop, void *inRefcon)
+{
+    FlightLoopEntry *loop = FindLegacyFlightLoop(inFlightLoop, inRefcon);
+    if (loop != NULL)
+        loop->used = 0;
+}
+
+XPLM_API void XPLMSetFlightLoopCallbackInterval(XPLMFlightLoop_f inFlightLoop, float inInterval, int inRelativeToNow, void *inRefcon)
+{
+    FlightLoopEntry *loop = FindLegacyFlightLoop(inFlightLoop, inRefcon);
+    if (loop != NULL)
+        ScheduleFlightLoop(loop, inInterval, inRelativeToNow ? elapsedTime : loop->lastCallTime);
+}
+
+XPLM_API XPLMFlightLoopID XPLMCreateFlightLoop(XPLMCreateFlightLoop_t *inParams)
+{
+    FlightLoopEntry *loop = AllocateFlightLoop(inParams->callbackFunc, inParams->refcon);
+    if (loop != NULL)
+        loop->phase = inParams->phase;
+
+    return loop;
+}
+
+XPLM_API void XPLMDestroyFlightLoop(XPLMFlightLoopID inFlightLoopID)
+{
+    if (inFlightLoopID != NULL)
+        ((FlightLoopEntry *) inFlightLoopID)->used = 0;
+}
+
+XPLM_API void XPLMScheduleFlightLoop(XPLMFlightLoopID inFlightLoopID, float inInterval, int inRelativeToNow)
+{
+    FlightLoopEntry *loop = (FlightLoopEntry *) inFlightLoopID;
+    if (loop != NULL)
+        ScheduleFlightLoop(loop, inInterval, inRelativeToNow ? elapsedTime : loop->lastCallTime);
+}
+
+static void RunFlightLoops(XPLMFlightLoopPhaseType inPhase)
+{
+    for (int i = 0; i < MAX_FLIGHT_LOOPS; i++)
+    {
+        FlightLoopEntry *loop = &flightLoops[i];
+        if (!loop->used || !loop->scheduled || loop->phase != inPhase)
+            continue;
+
+        if (loop->byFrames ? cycleNumber < loop->nextCycle : elapsedTime < loop->nextTime)
+            continue;
+
+        float elapsedSinceLastCall = elapsedTime - loop->lastCallTime;
+        loop->lastCallTime = elapsedTime;
+
+        float interval = loop->callback(elapsedSinceLastCall, lastFrameTime, cycleNumber, loop->refcon);
+
+        // the callback may have destroyed or rescheduled its own loop
+        if (loop->used)
+            ScheduleFlightLoop(loop, interval, elapsedTime);
+    }
+}
+
+// Log.txt of the stub host is stderr
+XPLM_API void XPLMDebugString(const char *inString)
+{
+    fputs(inString, stderr);
+}
+
+XPLM_API void XPLMGetSystemPath(char *outSystemPath)
+{
+    strcpy(outSystemPath, systemPath);
+}
+
+XPLM_API void XPLMStubSetSystemPath(const char *inSystemPath)
+{
+    snprintf(systemPath, sizeof(systemPath), "%s", inSystemPath);
+}
+
+XPLM_API const char *XPLMGetDirectorySeparator(void)
+{
+    return "/";
+}
+
+// the host only ever loads one plugin
+XPLM_API XPLMPluginID XPLMGetMyID(void)
+{
+    return 0;
+}
+
+XPLM_API void XPLMGetPluginInfo(XPLMPluginID inPlugin, char *outName, char *outFilePath, char *outSignature, char *outDescription)
+{
+    if (outName != NULL)
+        outName[0] = '\0';
+    if (outFilePath != NULL)
+        strcpy(outFilePath, pluginPath);
+    if (outSignature != NULL)
+        outSignature[0] = '\0';
+    if (outDescription != NULL)
+        outDescription[0] = '\0';
+}
+
+XPLM_API void XPLMStubSetPluginPath(const char *inPluginPath)
+{
+    snprintf(pluginPath, sizeof(pluginPath), "%s", inPluginPath);
+}
+
+XPLM_API void XPLMReadCameraPosition(XPLMCameraPosition_t *outCameraPosition)
+{
+    *outCameraPosition = cameraPosition;
+}
+
+XPLM_API void XPLMStubSetCameraPosition(const XPLMCameraPosition_t *inCameraPosition)
+{
+    cameraPosition = *inCameraPosition;
+}
+
+XPLM_API void XPLMStubSetFlightModel(XPLMStubFlightModel_f inFlightModel, void *inRefcon)
+{
+    flightModel = inFlightModel;
+    flightModelRefcon = inRefcon;
+}
+
+XPLM_API void XPLMStubRunFrame(float inFrameTime)
+{
+    cycleNumber++;
+    elapsedTime += inFrameTime;
+    lastFrameTime = inFrameTime;
+
+    RunFlightLoops(xplm_FlightLoop_Phase_BeforeFlightModel);
+
+    if (flightModel != NULL)
+        flightModel(inFrameTime, flightModelRefcon);
+
+    RunFlightLoops(xplm_FlightLoop_Phase_AfterFlightModel);
+}
+
+XPLM_API XPLMWindowID XPLMCreateWindow(int inLeft, int inTop, int inRight, int inBottom, int inIsVisible, XPLMDrawWindow_f inDrawCallback, XPLMHandleKey_f inKeyCallback, XPLMHandleMouseClick_f inMouseCallback, void *inRefcon)
+{
+    for (int i = 0; i < MAX_WINDOWS; i++)
+    {
+        if (!windows[i].used)
+        {
+            WindowEntry *window = &windows[i];
+            window->used = 1;
+            window->left = inLeft;
+            window->top = inTop;
+            window->right = inRight;
+            window->bottom = inBottom;
+            window->visible = inIsVisible;
+            window->draw = inDrawCallback;
+            window->refcon = inRefcon;
+
+            return window;
+        }
+    }
+
+    fprintf(stderr, "XPLMStub: window table full\n");
+
+    return NULL;
+}
+
+XPLM_API void XPLMDestroyWindow(XPLMWindowID inWindowID)
+{
+    if (inWindowID != NULL)
+        ((WindowEntry *) inWindowID)->used = 0;
+}
+
+XPLM_API void XPLMGetWindowGeometry(XPLMWindowID inWindowID, int *outLeft, int *outTop, int *outRight, int *outBottom)
+{
+    WindowEntry *window = (WindowEntry *) inWindowID;
+
+    if (outLeft != NULL)
+        *outLeft = window->left;
+    if (outTop != NULL)
+        *outTop = window->top;
+    if (outRight != NULL)
+        *outRight = window->right;
+    if (outBottom != NULL)
+        *outBottom = window->bottom;
+}
+
+XPLM_API void XPLMSetWindowGeometry(XPLMWindowID inWindowID, int inLeft, int inTop, int inRight, int inBottom)
+{
+    WindowEntry *window = (WindowEntry *) inWindowID;
+    window->left = inLeft;
+    window->top = inTop;
+    window->right = inRight;
+    window->bottom = inBottom;
+}
+
+XPLM_API int XPLMGetWindowIsVisible(XPLMWindowID inWindowID)
+{
+    return ((WindowEntry *) inWindowID)->visible;
+}
+
+XPLM_API void XPLMSetWindowIsVisible(XPLMWindowID inWindowID, int inIsVisible)
+{
+    ((WindowEntry *) inWindowID)->visible = inIsVisible;
+}
+
+XPLM_API void XPLMTakeKeyboardFocus(XPLMWindowID inWindow)
+{
+}
+
+XPLM_API void XPLMBringWindowToFront(XPLMWindowID inWindow)
+{
+}
+
+XPLM_API int XPLMIsWindowInFront(XPLMWindowID inWindow)
+{
+    return 1;
+}
+
+XPLM_API int XPLMRegisterKeySniffer(XPLMKeySniffer_f inCallback, int inBeforeWindows, void *inRefcon)
+{
+    return 1;
+}
+
+XPLM_API int XPLMUnregisterKeySniffer(XPLMKeySniffer_f inCallback, int inBeforeWindows, void *inRefcon)
+{
+    return 1;
+}
+
+XPLM_API void XPLMGetScreenSize(int *outWidth, int *outHeight)
+{
+    if (outWidth != NULL)
+        *outWidth = SCREEN_WIDTH;
+    if (outHeight != NULL)
+        *outHeight = SCREEN_HEIGHT;
+}
+
+XPLM_API void XPLMSetGraphicsState(int inEnableFog, int inNumberTexUnits, int inEnableLighting, int inEnableAlphaTesting, int inEnableAlphaBlending, int inEnableDepthTesting, int inEnableDepthWriting)
+{
+}
+
+XPLM_API void XPLMDrawTranslucentDarkBox(int inLeft, int inTop, int inRight, int inBottom)
+{
+}
+
+XPLM_API void XPLMDrawString(float *inColorRGB, int inXOffset, int inYOffset, char *inChar, int *inWordWrapWidth, XPLMFontID inFontID)
+{
+}
+
+XPLM_API void XPLMGetFontDimensions(XPLMFontID inFontID, int *outCharWidth, int *outCharHeight, int *outDigitsOnly)
+{
+    if (outCharWidth != NULL)
+        *outCharWidth = CHAR_WIDTH;
+    if (outCharHeight != NULL)
+        *outCharHeight = CHAR_HEIGHT;
+    if (outDigitsOnly != NULL)
+        *outDigitsOnly = 0;
+}
+
+XPLM_API float XPLMMeasureString(XPLMFontID inFontID, const char *inChar, int inNumChars)
+{
+    return (float) (inNumChars * CHAR_WIDTH);
+}
+
+XPLM_API XPLMMenuID XPLMFindPluginsMenu(void)
+{
+    return &pluginsMenu;
+}
+
+XPLM_API XPLMMenuID XPLMCreateMenu(const char *inName, XPLMMenuID inParentMenu, int inParentItem, XPLMMenuHandler_f inHandler, void *inMenuRef)
+{
+    for (int i = 0; i < MAX_MENUS; i++)
+    {
+        if (!menus[i].used)
+        {
+            MenuEntry *menu = &menus[i];
+            memset(menu, 0, sizeof(MenuEntry));
+            menu->used = 1;
+            menu->handler = inHandler;
+            menu->menuRef = inMenuRef;
+
+            return menu;
+        }
+    }
+
+    fprintf(stderr, "XPLMStub: menu table full, cannot add %s\n", inName);
+
+    return NULL;
+}
+
+XPLM_API void XPLMDestroyMenu(XPLMMenuID inMenuID)
+{
+    if (inMenuID != NULL && inMenuID != &pluginsMenu)
+        ((MenuEntry *) inMenuID)->used = 0;
+}
+
+XPLM_API int XPLMAppendMenuItem(XPLMMenuID inMenu, const char *inItemName, void *inItemRef, int inForceEnglish)
+{
+    MenuEntry *menu = (MenuEntry *) inMenu;
+    if (menu == NULL || menu->itemCount == MAX_MENU_ITEMS)
+        return -1;
+
+    MenuItemEntry *item = &menu->items[menu->itemCount];
+    strncpy(item->name, inItemName, MAX_NAME_LENGTH - 1);
+    item->name[MAX_NAME_LENGTH - 1] = '\0';
+    item->itemRef = inItemRef;
+    item->check = xplm_Menu_NoCheck;
+
+    return menu->itemCount++;
+}
+
+XPLM_API void XPLMCheckMenuItem(XPLMMenuID inMenu, int index, XPLMMenuCheck inCheck)
+{
+    MenuEntry *menu = (MenuEntry *) inMenu;
+    if (menu != NULL && index >= 0 && index < menu->itemCount)
+        menu->items[index].check = inCheck;
+}
+
+XPLM_API void XPLMCheckMenuItemState(XPLMMenuID inMenu, int index, XPLMMenuCheck *outCheck)
+{
+    MenuEntry *menu = (MenuEntry *) inMenu;
+    if (menu != NULL && index >= 0 && index < menu->itemCount)
+        *outCheck = menu->items[index].check;
+}
+
+XPLM_API void XPLMRemoveMenuItem(XPLMMenuID inMenu, int inIndex)
+{
+    MenuEntry *menu = (MenuEntry *) inMenu;
+    if (menu == NULL || inIndex < 0 || inIndex >= menu->itemCount)
+        return;
+
+    memmove(&menu->items[inIndex], &menu->items[inIndex + 1], (menu->itemCount - inIndex - 1) * sizeof(MenuItemEntry));
+    menu->itemCount--;
+}
+
+XPLM_API int XPLMStubSelectMenuItem(const char *inItemName)
+{
+    for (int i = 0; i < MAX_MENUS; i++)
+    {
+        MenuEntry *menu = &menus[i];
+        if (!menu->used || menu->handler == NULL)
+            continue;
+
+        for (int j = 0; j < menu->itemCount; j++)
+        {
+            if (strcmp(menu->items[j].name, inItemName) == 0)
+            {
+                menu->handler(menu->menuRef, menu->items[j].itemRef);
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+XPLM_API void XPLMStubDrawWindows(void)
+{
+    for (int i = 0; i < MAX_WINDOWS; i++)
+    {
+        WindowEntry *window = &windows[i];
+        if (window->used && window->visible && window->draw != NULL)
+            window->draw(window, window->refcon);
+    }
+}
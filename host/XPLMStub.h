@@ -0,0 +1,67 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef XPLM_STUB_H
+#define XPLM_STUB_H
+
+// host side interface of the stub XPLM library that stands in for X-Plane
+// when the plugin is run headless
+
+#include "XPLMCamera.h"
+#include "XPLMDataAccess.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// creates a sim dataref that is backed by memory owned by the stub host
+// scalar types may be read and written as int, float or double; array types
+// hold up to XPLM_STUB_MAX_ARRAY elements
+#define XPLM_STUB_MAX_ARRAY 16
+XPLM_API XPLMDataRef XPLMStubCreateDataRef(const char *inDataName, XPLMDataTypeID inDataType, int inCount);
+
+// sets the folder XPLMGetSystemPath returns, including the trailing separator,
+// the default is the current directory
+XPLM_API void XPLMStubSetSystemPath(const char *inSystemPath);
+
+// sets the file XPLMGetPluginInfo reports for the plugin, the default is empty
+XPLM_API void XPLMStubSetPluginPath(const char *inPluginPath);
+
+// sets the position XPLMReadCameraPosition returns, the default is the origin
+XPLM_API void XPLMStubSetCameraPosition(const XPLMCameraPosition_t *inCameraPosition);
+
+// host callback that stands in for the flight model, run once per frame
+// between the before and after flight model phases
+typedef void (*XPLMStubFlightModel_f)(float inFrameTime, void *inRefcon);
+XPLM_API void XPLMStubSetFlightModel(XPLMStubFlightModel_f inFlightModel, void *inRefcon);
+
+// advances the simulated time by inFrameTime seconds and runs all flight loop
+// callbacks that are due in this frame, in phase order around the flight model
+XPLM_API void XPLMStubRunFrame(float inFrameTime);
+
+// calls the handler of the first menu item with the given name, returns 0 if
+// there is none
+XPLM_API int XPLMStubSelectMenuItem(const char *inItemName);
+
+// calls the draw callbacks of all visible windows
+XPLM_API void XPLMStubDrawWindows(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,474 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// headless driver that loads lin.xpl against the stub XPLM library and ticks
+// its flight loops with synthetic sim inputs
+//
+// a synthetic flight model runs between the flight loop phases and every
+// frame is checked for the plugin's outputs being visible in the same frame
+// they were computed: the shudder has to reach the flight model and the disc
+// tilt override has to survive it
+//
+// with the worker thread enabled the published channels are expected to lag
+// exactly one frame behind, while the sim outputs are still checked against
+// the frame they were computed in
+//
+// with shared data enabled the driver subscribes to some of the shared
+// channels like another plugin would and checks that they are only notified
+// of actual changes and match the accessor datarefs after every frame
+
+#include "XPLMStub.h"
+#include "XPLMPlanes.h"
+#include "XPLMPlugin.h"
+
+#include <dlfcn.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// define defaults
+#define DEFAULT_PLUGIN "build/hughes_500d/64/lin.xpl"
+#define DEFAULT_FRAMES 1000000
+#define DEFAULT_FRAME_RATE 60.0f
+#define MAX_REPORTED_FAILURES 5
+#define SHUDDER_TOLERANCE 1e-4f
+#define SHARED_CHECKS 3
+
+typedef int (*XPluginStart_f)(char *outName, char *outSig, char *outDesc);
+typedef void (*XPluginStop_f)(void);
+typedef int (*XPluginEnable_f)(void);
+typedef void (*XPluginDisable_f)(void);
+typedef void (*XPluginReceiveMessage_f)(XPLMPluginID inFromWho, long inMessage, void *inParam);
+
+// sim datarefs the plugin consumes
+static XPLMDataRef acfNumBladesDataRef = NULL, acfCyclicAilnDataRef = NULL, acfCyclicElevDataRef = NULL, audioPanelOutDataRef = NULL, flaprqstDataRef = NULL, cyclicElevDiscTiltDataRef = NULL, cyclicAilnDiscTiltDataRef = NULL, pointPitchDegDataRef = NULL, pointTacradDataRef = NULL, ongroundAnyDataRef = NULL, localXDataRef = NULL, localZDataRef = NULL, phiDataRef = NULL, psiDataRef = NULL, pDotDataRef = NULL, qDotDataRef = NULL, viewXDataRef = NULL, viewZDataRef = NULL, yolkPitchRatioDataRef = NULL, yolkRollRatioDataRef = NULL, frameRatePeriodDataRef = NULL;
+
+// plugin datarefs the check reads back
+static XPLMDataRef mutingLowPitchDataRef = NULL, mutingLowRollDataRef = NULL;
+
+// what the flight model is expected to see and what it computed in one frame
+struct FrameCheck
+{
+    float expectedPDot;
+    float expectedQDot;
+    float discTiltElev;
+    float discTiltAiln;
+    int worker;
+    float publishedMutingPitch;
+    float publishedMutingRoll;
+    int failures;
+};
+
+// a shared channel the driver subscribes to
+struct SharedCheck
+{
+    const char *name;
+    const char *accessorName;
+    XPLMDataRef dataRef;
+    XPLMDataRef accessorDataRef;
+    float value;
+    int notifications;
+    FrameCheck *check;
+};
+
+static SharedCheck sharedChecks[SHARED_CHECKS] =
+{
+    {"abb/shared/doors/left/cockpit/position", "abb/doors/left/cockpit/position"},
+    {"abb/shared/rotor/disc/tilt/pitch/muting/low", "abb/rotor/disc/tilt/pitch/muting/low"},
+    {"abb/shared/rotor/position/degrees/main", "abb/rotor/position/degrees/main"}
+};
+
+static void CreateSimDataRefs(void)
+{
+    acfNumBladesDataRef = XPLMStubCreateDataRef("sim/aircraft/prop/acf_num_blades", xplmType_FloatArray, 8);
+    acfCyclicAilnDataRef = XPLMStubCreateDataRef("sim/aircraft/vtolcontrols/acf_cyclic_ailn", xplmType_Float, 1);
+    acfCyclicElevDataRef = XPLMStubCreateDataRef("sim/aircraft/vtolcontrols/acf_cyclic_elev", xplmType_Float, 1);
+    audioPanelOutDataRef = XPLMStubCreateDataRef("sim/cockpit/switches/audio_panel_out", xplmType_Int, 1);
+    flaprqstDataRef = XPLMStubCreateDataRef("sim/flightmodel/controls/flaprqst", xplmType_Float, 1);
+    cyclicElevDiscTiltDataRef = XPLMStubCreateDataRef("sim/flightmodel/cyclic/cyclic_elev_disc_tilt", xplmType_FloatArray, 8);
+    cyclicAilnDiscTiltDataRef = XPLMStubCreateDataRef("sim/flightmodel/cyclic/cyclic_ailn_disc_tilt", xplmType_FloatArray, 8);
+    pointPitchDegDataRef = XPLMStubCreateDataRef("sim/flightmodel/engine/POINT_pitch_deg", xplmType_FloatArray, 8);
+    pointTacradDataRef = XPLMStubCreateDataRef("sim/flightmodel/engine/POINT_tacrad", xplmType_FloatArray, 8);
+    ongroundAnyDataRef = XPLMStubCreateDataRef("sim/flightmodel/failures/onground_any", xplmType_Int, 1);
+    localXDataRef = XPLMStubCreateDataRef("sim/flightmodel/position/local_x", xplmType_Double, 1);
+    localZDataRef = XPLMStubCreateDataRef("sim/flightmodel/position/local_z", xplmType_Double, 1);
+    phiDataRef = XPLMStubCreateDataRef("sim/flightmodel/position/phi", xplmType_Float, 1);
+    psiDataRef = XPLMStubCreateDataRef("sim/flightmodel/position/psi", xplmType_Float, 1);
+    pDotDataRef = XPLMStubCreateDataRef("sim/flightmodel/position/P_dot", xplmType_Float, 1);
+    qDotDataRef = XPLMStubCreateDataRef("sim/flightmodel/position/Q_dot", xplmType_Float, 1);
+    viewXDataRef = XPLMStubCreateDataRef("sim/graphics/view/view_x", xplmType_Float, 1);
+    viewZDataRef = XPLMStubCreateDataRef("sim/graphics/view/view_z", xplmType_Float, 1);
+    yolkPitchRatioDataRef = XPLMStubCreateDataRef("sim/joystick/yolk_pitch_ratio", xplmType_Float, 1);
+    yolkRollRatioDataRef = XPLMStubCreateDataRef("sim/joystick/yolk_roll_ratio", xplmType_Float, 1);
+    frameRatePeriodDataRef = XPLMStubCreateDataRef("sim/operation/misc/frame_rate_period", xplmType_Float, 1);
+}
+
+static void SetFloatArrayElement(XPLMDataRef dataRef, int index, float value)
+{
+    XPLMSetDatavf(dataRef, &value, index, 1);
+}
+
+static float GetFloatArrayElement(XPLMDataRef dataRef, int index)
+{
+    float value = 0.0f;
+    XPLMGetDatavf(dataRef, &value, index, 1);
+
+    return value;
+}
+
+static void ReportFailure(FrameCheck *check, const char *what, float expected, float actual)
+{
+    if (check->failures++ < MAX_REPORTED_FAILURES)
+        fprintf(stderr, "%s: expected %g, got %g\n", what, expected, actual);
+}
+
+// writes synthetic sim inputs for the given frame: the rotor spins up through
+// the muting threshold, the cyclic is stirred, the doors cycle every 10
+// seconds, the aircraft alternates between ground and air, the audio panel
+// selector steps through all positions and the camera circles the aircraft,
+// moving out to 200 m and back every two minutes
+static void SetSyntheticInputs(int frame, float time, float frameRatePeriod)
+{
+    float spinUp = time < 20.0f ? time / 20.0f : 1.0f;
+
+    XPLMSetDataf(frameRatePeriodDataRef, frameRatePeriod);
+    SetFloatArrayElement(pointTacradDataRef, 0, 50.0f * spinUp);
+    SetFloatArrayElement(pointTacradDataRef, 1, 300.0f * spinUp);
+    SetFloatArrayElement(pointTacradDataRef, 4, 10.0f * sinf(time));
+    SetFloatArrayElement(pointTacradDataRef, 5, 10.0f * cosf(time));
+    SetFloatArrayElement(pointPitchDegDataRef, 0, 4.0f + 2.0f * sinf(time * 0.1f));
+    XPLMSetDataf(yolkPitchRatioDataRef, sinf(time * 0.5f));
+    XPLMSetDataf(yolkRollRatioDataRef, cosf(time * 0.3f));
+    XPLMSetDataf(flaprqstDataRef, fmodf(time, 20.0f) < 10.0f ? 1.0f : 0.0f);
+    XPLMSetDatai(ongroundAnyDataRef, fmodf(time, 60.0f) < 30.0f ? 1 : 0);
+    XPLMSetDatad(localXDataRef, 100.0 + time);
+    XPLMSetDatad(localZDataRef, -50.0);
+    float cameraDistance = 2.0f + 99.0f * (1.0f - cosf(time * (float) (M_PI / 60.0)));
+    XPLMCameraPosition_t camera = {100.0f + time + cameraDistance * cosf(time * 0.2f), 0.0f, -50.0f + cameraDistance * sinf(time * 0.2f), 0.0f, 0.0f, 0.0f, 1.0f};
+    XPLMStubSetCameraPosition(&camera);
+    XPLMSetDataf(viewXDataRef, camera.x);
+    XPLMSetDataf(viewZDataRef, camera.z);
+    XPLMSetDataf(phiDataRef, 20.0f * sinf(time * 0.25f));
+    XPLMSetDataf(psiDataRef, fmodf(time * 3.0f, 360.0f));
+    XPLMSetDataf(pDotDataRef, 0.5f * sinf(time * 2.0f));
+    XPLMSetDataf(qDotDataRef, 0.5f * cosf(time * 2.0f));
+
+    static const int audioPanelPositions[] = {0, 1, 2, 3, 5, 10, 11};
+    XPLMSetDatai(audioPanelOutDataRef, audioPanelPositions[(frame / 120) % 7]);
+}
+
+// computes the transitional shudder the plugin has to hand to the flight model
+// from the inputs of the current frame
+static void ExpectShudder(FrameCheck *check)
+{
+    float pDot = XPLMGetDataf(pDotDataRef);
+    float qDot = XPLMGetDataf(qDotDataRef);
+
+    if (XPLMGetDatai(ongroundAnyDataRef))
+    {
+        pDot *= 0.001f;
+        qDot *= 0.5f;
+    }
+
+    check->expectedPDot = pDot + sinf(GetFloatArrayElement(pointTacradDataRef, 4) * 0.03f) * GetFloatArrayElement(pointTacradDataRef, 0) * 0.05f;
+    check->expectedQDot = qDot + sinf(GetFloatArrayElement(pointTacradDataRef, 5) * 0.03f) * GetFloatArrayElement(pointTacradDataRef, 1) * 0.005f;
+}
+
+// stands in for the flight model: checks that the shudder written before it is
+// what it integrates, then computes the disc tilt from the cyclic
+static void FlightModel(float inFrameTime, void *inRefcon)
+{
+    FrameCheck *check = (FrameCheck *) inRefcon;
+
+    float pDot = XPLMGetDataf(pDotDataRef);
+    float qDot = XPLMGetDataf(qDotDataRef);
+    if (fabsf(pDot - check->expectedPDot) > SHUDDER_TOLERANCE)
+        ReportFailure(check, "P_dot seen by the flight model", check->expectedPDot, pDot);
+    if (fabsf(qDot - check->expectedQDot) > SHUDDER_TOLERANCE)
+        ReportFailure(check, "Q_dot seen by the flight model", check->expectedQDot, qDot);
+
+    check->discTiltElev = 3.0f * XPLMGetDataf(yolkPitchRatioDataRef);
+    check->discTiltAiln = 3.0f * XPLMGetDataf(yolkRollRatioDataRef);
+    SetFloatArrayElement(cyclicElevDiscTiltDataRef, 0, check->discTiltElev);
+    SetFloatArrayElement(cyclicAilnDiscTiltDataRef, 0, check->discTiltAiln);
+}
+
+// checks what gets drawn at the end of the frame: the disc tilt override has
+// to reflect the disc tilt of this frame and the muting channels that of this
+// frame, or of the previous one with the worker
+static void CheckDiscTilt(FrameCheck *check)
+{
+    int muted = GetFloatArrayElement(pointTacradDataRef, 0) >= 15.0f;
+
+    float discTiltElev = GetFloatArrayElement(cyclicElevDiscTiltDataRef, 0);
+    float discTiltAiln = GetFloatArrayElement(cyclicAilnDiscTiltDataRef, 0);
+    float mutingLowPitch = XPLMGetDataf(mutingLowPitchDataRef);
+    float mutingLowRoll = XPLMGetDataf(mutingLowRollDataRef);
+
+    if (discTiltElev != (muted ? 0.0f : check->discTiltElev))
+        ReportFailure(check, "cyclic_elev_disc_tilt after the frame", muted ? 0.0f : check->discTiltElev, discTiltElev);
+    if (discTiltAiln != (muted ? 0.0f : check->discTiltAiln))
+        ReportFailure(check, "cyclic_ailn_disc_tilt after the frame", muted ? 0.0f : check->discTiltAiln, discTiltAiln);
+
+    float expectedMutingPitch = muted ? check->discTiltElev : 0.0f;
+    float expectedMutingRoll = muted ? check->discTiltAiln : 0.0f;
+    if (check->worker)
+    {
+        float previousMutingPitch = check->publishedMutingPitch;
+        float previousMutingRoll = check->publishedMutingRoll;
+        check->publishedMutingPitch = expectedMutingPitch;
+        check->publishedMutingRoll = expectedMutingRoll;
+        expectedMutingPitch = previousMutingPitch;
+        expectedMutingRoll = previousMutingRoll;
+    }
+
+    if (mutingLowPitch != expectedMutingPitch)
+        ReportFailure(check, "pitch muting after the frame", expectedMutingPitch, mutingLowPitch);
+    if (mutingLowRoll != expectedMutingRoll)
+        ReportFailure(check, "roll muting after the frame", expectedMutingRoll, mutingLowRoll);
+}
+
+// notification of a shared channel, the refcon is its check
+static void SharedDataChanged(void *inRefcon)
+{
+    SharedCheck *shared = (SharedCheck *) inRefcon;
+
+    float value = XPLMGetDataf(shared->dataRef);
+    if (value == shared->value)
+        ReportFailure(shared->check, "shared data notified without a change", shared->value, value);
+
+    shared->value = value;
+    shared->notifications++;
+}
+
+// subscribes to the shared channels before the plugin shares them
+static void ShareChannels(FrameCheck *check)
+{
+    for (int i = 0; i < SHARED_CHECKS; i++)
+    {
+        SharedCheck *shared = &sharedChecks[i];
+        shared->check = check;
+        shared->value = NAN;
+        XPLMShareData(shared->name, xplmType_Float, SharedDataChanged, shared);
+        shared->dataRef = XPLMFindDataRef(shared->name);
+    }
+}
+
+// checks that the shared channels match the accessor datarefs after the frame
+static void CheckSharedChannels(FrameCheck *check)
+{
+    for (int i = 0; i < SHARED_CHECKS; i++)
+    {
+        SharedCheck *shared = &sharedChecks[i];
+        if (shared->accessorDataRef == NULL)
+            shared->accessorDataRef = XPLMFindDataRef(shared->accessorName);
+
+        float expected = XPLMGetDataf(shared->accessorDataRef);
+        float value = XPLMGetDataf(shared->dataRef);
+        if (value != expected)
+            ReportFailure(check, shared->name, expected, value);
+    }
+}
+
+static double Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void Usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-n frames] [-f fps] [-p] [-o] [-w] [-s] [-t dir] [plugin.xpl]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *pluginPath = DEFAULT_PLUGIN;
+    int frames = DEFAULT_FRAMES;
+    float frameRate = DEFAULT_FRAME_RATE;
+    int profile = 0, overlay = 0, worker = 0, share = 0;
+    const char *telemetryDir = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            frames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            frameRate = atof(argv[++i]);
+        else if (strcmp(argv[i], "-p") == 0)
+            profile = 1;
+        else if (strcmp(argv[i], "-o") == 0)
+            overlay = 1;
+        else if (strcmp(argv[i], "-w") == 0)
+            worker = 1;
+        else if (strcmp(argv[i], "-s") == 0)
+            share = 1;
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            telemetryDir = argv[++i];
+        else if (argv[i][0] == '-')
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+        else
+            pluginPath = argv[i];
+    }
+
+    if (frames <= 0 || frameRate <= 0.0f)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    CreateSimDataRefs();
+
+    // the aircraft data of the 500D's five bladed main rotor
+    SetFloatArrayElement(acfNumBladesDataRef, 0, 5.0f);
+    XPLMSetDataf(acfCyclicAilnDataRef, 10.0f);
+    XPLMSetDataf(acfCyclicElevDataRef, 12.0f);
+
+    // telemetry files are written to the X-Plane folder
+    if (telemetryDir != NULL)
+    {
+        char systemPath[512];
+        snprintf(systemPath, sizeof(systemPath), "%s/", telemetryDir);
+        XPLMStubSetSystemPath(systemPath);
+    }
+
+    // the plugin looks for its animation tracks next to itself
+    XPLMStubSetPluginPath(pluginPath);
+
+    void *plugin = dlopen(pluginPath, RTLD_NOW | RTLD_LOCAL);
+    if (plugin == NULL)
+    {
+        fprintf(stderr, "cannot load %s: %s\n", pluginPath, dlerror());
+        return 1;
+    }
+
+    XPluginStart_f pluginStart = (XPluginStart_f) dlsym(plugin, "XPluginStart");
+    XPluginStop_f pluginStop = (XPluginStop_f) dlsym(plugin, "XPluginStop");
+    XPluginEnable_f pluginEnable = (XPluginEnable_f) dlsym(plugin, "XPluginEnable");
+    XPluginDisable_f pluginDisable = (XPluginDisable_f) dlsym(plugin, "XPluginDisable");
+    XPluginReceiveMessage_f pluginReceiveMessage = (XPluginReceiveMessage_f) dlsym(plugin, "XPluginReceiveMessage");
+    if (pluginStart == NULL || pluginStop == NULL || pluginEnable == NULL || pluginDisable == NULL || pluginReceiveMessage == NULL)
+    {
+        fprintf(stderr, "%s does not export the plugin entry points\n", pluginPath);
+        return 1;
+    }
+
+    char name[256], sig[256], desc[256];
+    if (!pluginStart(name, sig, desc))
+    {
+        fprintf(stderr, "%s failed to start\n", pluginPath);
+        return 1;
+    }
+
+    if (telemetryDir != NULL)
+        XPLMSetDatai(XPLMFindDataRef("abb/telemetry/enabled"), 1);
+
+    // the worker starts with the first frame
+    if (worker)
+    {
+        XPLMSetDatai(XPLMFindDataRef("abb/worker/enabled"), 1);
+        if (!XPLMGetDatai(XPLMFindDataRef("abb/worker/enabled")))
+        {
+            fprintf(stderr, "%s has no worker thread\n", pluginPath);
+            return 1;
+        }
+    }
+
+    FrameCheck check;
+    memset(&check, 0, sizeof(check));
+    check.worker = worker;
+
+    // the shared channels are set from the first frame on
+    if (share)
+    {
+        ShareChannels(&check);
+        XPLMSetDatai(XPLMFindDataRef("abb/share/enabled"), 1);
+    }
+
+    if (!pluginEnable())
+    {
+        fprintf(stderr, "%s failed to start\n", pluginPath);
+        return 1;
+    }
+
+    printf("loaded %s (%s)\n", name, sig);
+
+    // X-Plane loads the user's aircraft after the plugins are enabled
+    pluginReceiveMessage(XPLM_NO_PLUGIN_ID, XPLM_MSG_PLANE_LOADED, (void *) XPLM_USER_AIRCRAFT);
+
+    mutingLowPitchDataRef = XPLMFindDataRef("abb/rotor/disc/tilt/pitch/muting/low");
+    mutingLowRollDataRef = XPLMFindDataRef("abb/rotor/disc/tilt/roll/muting/low");
+
+    // the plugin dumps its profile on stop
+    if (profile)
+        XPLMSetDatai(XPLMFindDataRef("abb/perf/enabled"), 1);
+
+    // the overlay is drawn once per frame, without a GL context its drawing
+    // calls do nothing but the cost of preparing them is measured
+    if (overlay && !XPLMStubSelectMenuItem("Performance Overlay"))
+    {
+        fprintf(stderr, "%s has no performance overlay\n", pluginPath);
+        return 1;
+    }
+
+    XPLMStubSetFlightModel(FlightModel, &check);
+
+    float frameRatePeriod = 1.0f / frameRate;
+    double runStart = Now(), simulationTime = 0.0;
+
+    for (int frame = 0; frame < frames; frame++)
+    {
+        SetSyntheticInputs(frame, (float) simulationTime, frameRatePeriod);
+        ExpectShudder(&check);
+        XPLMStubRunFrame(frameRatePeriod);
+        if (overlay)
+            XPLMStubDrawWindows();
+        CheckDiscTilt(&check);
+        if (share)
+            CheckSharedChannels(&check);
+        simulationTime += frameRatePeriod;
+    }
+
+    double runTime = Now() - runStart;
+
+    printf("%d frames in %.3f s, %.1f ns/frame\n", frames, runTime, runTime * 1e9 / frames);
+    printf("governor at level %d\n", XPLMGetDatai(XPLMFindDataRef("abb/governor/level")));
+
+    if (share)
+    {
+        for (int i = 0; i < SHARED_CHECKS; i++)
+            printf("%d notifications for %s\n", sharedChecks[i].notifications, sharedChecks[i].name);
+    }
+
+    if (check.failures > 0)
+        printf("%d outputs not visible in the frame they were computed\n", check.failures);
+    else
+        printf("all outputs visible in the frame they were computed\n");
+
+    pluginDisable();
+    pluginStop();
+    dlclose(plugin);
+
+    return check.failures > 0;
+}
@@ -15,10 +15,67 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include "XPCDisplay.h"
+#include "XPLMCamera.h"
 #include "XPLMDataAccess.h"
+#include "XPLMGraphics.h"
+#include "XPLMMenus.h"
+#include "XPLMPlanes.h"
+#include "XPLMPlugin.h"
 #include "XPLMProcessing.h"
+#include "XPLMUtilities.h"
+
+#include "fast_math.h"
+#include "profiler.h"
+#include "tracks.h"
+
+// define to 1 to build the telemetry recorder, it needs POSIX threads and
+// memory mapped files and is only enabled on linux by default
+#ifndef TELEMETRY
+#define TELEMETRY LIN
+#endif
+
+#if TELEMETRY
+#include "telemetry.h"
+#endif
+
+// define to 1 to build the worker thread that animates off the sim thread, it
+// needs POSIX threads and is only enabled on linux by default
+#ifndef WORKER
+#define WORKER LIN
+#endif
+
+#if WORKER
+#include "worker.h"
+#endif
+
+// define to 1 to build the reader for the tuning file next to the plugin, it
+// needs memory mapped files and is only enabled on linux by default, other
+// builds run with the built-in tuning
+#ifndef TUNING
+#define TUNING LIN
+#endif
+
+#if TUNING
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if IBM
+#include <windows.h>
+#endif
+#if APL
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
 
 #include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 
 // define name
@@ -28,77 +85,1026 @@
 // define version
 #define VERSION "0.1"
 
-// define constants
-#define MAX_DOOR_SPEED 0.8f
-#define MAX_ROTATION 720.0f
-#define HEAD_ROTATION_SPEED 150.0f
+// define to 1 to run the individual Update* functions instead of the fused
+// single pass kernel
+#ifndef REFERENCE_UPDATE
+#define REFERENCE_UPDATE 0
+#endif
+
+// define to 0 to run all subsystems that animate after the flight model every
+// frame from a single flight loop
+#ifndef SCHEDULED_UPDATE
+#define SCHEDULED_UPDATE 1
+#endif
+
+// update intervals of the separately scheduled subsystems, positive values are
+// seconds, negative values are frames
+// the doors interval only applies while they are moving, at rest their flight
+// loop is not scheduled at all
+#ifndef ROTOR_INTERVAL
+#define ROTOR_INTERVAL -1.0f
+#endif
+#ifndef PILOT_INTERVAL
+#define PILOT_INTERVAL (1.0f / 30.0f)
+#endif
+#ifndef SWITCHES_INTERVAL
+#define SWITCHES_INTERVAL 0.1f
+#endif
+#ifndef DOORS_INTERVAL
+#define DOORS_INTERVAL -1.0f
+#endif
+
+// define to 1 to start with the profiler enabled, it can also be switched on
+// and off at runtime through abb/perf/enabled
+#ifndef PROFILER
+#define PROFILER 0
+#endif
+
+// define to 1 to start with the animation running on the worker thread, it can
+// also be switched on and off at runtime through abb/worker/enabled
+// the worker is handed the inputs of every frame and publishes its results at
+// the end of the next one, so the published channels lag one frame behind;
+// the shudder and the disc tilt override are written to the sim and always
+// stay on the sim thread
+#ifndef WORKER_ENABLED
+#define WORKER_ENABLED 0
+#endif
+
+// published channels
+enum
+{
+    CHANNEL_DOORS_LEFT_POSITION,
+    CHANNEL_DOORS_RIGHT_POSITION,
+    CHANNEL_ADF1,
+    CHANNEL_ADF2,
+    CHANNEL_COM1,
+    CHANNEL_COM2,
+    CHANNEL_DME,
+    CHANNEL_NAV1,
+    CHANNEL_NAV2,
+    CHANNEL_TACRADS_HIGH_MAIN,
+    CHANNEL_TACRADS_HIGH_TAIL,
+    CHANNEL_HEAD_HEADING,
+    CHANNEL_ROTOR_BLADES_CONING,
+    CHANNEL_ROTOR_BLADES_FLAP_0,
+    CHANNEL_ROTOR_BLADES_FLAP_1,
+    CHANNEL_ROTOR_BLADES_FLAP_2,
+    CHANNEL_ROTOR_BLADES_FLAP_3,
+    CHANNEL_ROTOR_BLADES_FLAP_4,
+    CHANNEL_ROTOR_BLADES_LAG_0,
+    CHANNEL_ROTOR_BLADES_LAG_1,
+    CHANNEL_ROTOR_BLADES_LAG_2,
+    CHANNEL_ROTOR_BLADES_LAG_3,
+    CHANNEL_ROTOR_BLADES_LAG_4,
+    CHANNEL_ROTOR_BLADES_PITCH_0,
+    CHANNEL_ROTOR_BLADES_PITCH_1,
+    CHANNEL_ROTOR_BLADES_PITCH_2,
+    CHANNEL_ROTOR_BLADES_PITCH_3,
+    CHANNEL_ROTOR_BLADES_PITCH_4,
+    CHANNEL_ROTOR_MUTING_LOW_PITCH,
+    CHANNEL_ROTOR_MUTING_LOW_ROLL,
+    CHANNEL_ROTOR_POSITION_MAIN,
+    CHANNEL_ROTOR_POSITION_MAIN_MUTING,
+    CHANNEL_ROTOR_POSITION_TAIL,
+    CHANNEL_ROTOR_POSITION_TAIL_MUTING,
+    CHANNEL_ROTOR_POSITION_MAIN_FPS_MUTING,
+    CHANNEL_ROTOR_POSITION_TAIL_FPS_MUTING,
+    CHANNEL_COUNT
+};
+
+// describes the dataref that publishes a channel
+struct ChannelDescriptor
+{
+    const char *name;
+    XPLMDataTypeID type;
+    int writable;
+};
+
+static const ChannelDescriptor channelDescriptors[CHANNEL_COUNT] =
+{
+    {"abb/doors/left/cockpit/position", xplmType_Float, 1},
+    {"abb/doors/right/cockpit/position", xplmType_Float, 1},
+    {"abb/flags/audio/panel/adf1", xplmType_Float, 1},
+    {"abb/flags/audio/panel/adf2", xplmType_Float, 1},
+    {"abb/flags/audio/panel/com1", xplmType_Float, 1},
+    {"abb/flags/audio/panel/com2", xplmType_Float, 1},
+    {"abb/flags/audio/panel/dme", xplmType_Float, 1},
+    {"abb/flags/audio/panel/nav1", xplmType_Float, 1},
+    {"abb/flags/audio/panel/nav2", xplmType_Float, 1},
+    {"abb/flags/rotor/disc/tacrads/high/main", xplmType_Float, 1},
+    {"abb/flags/rotor/disc/tacrads/high/tail", xplmType_Float, 1},
+    {"abb/pilot/head/heading/degrees", xplmType_Float, 1},
+    {"abb/rotor/blades/coning", xplmType_Float, 0},
+    {"abb/rotor/blades/flap/0", xplmType_Float, 0},
+    {"abb/rotor/blades/flap/1", xplmType_Float, 0},
+    {"abb/rotor/blades/flap/2", xplmType_Float, 0},
+    {"abb/rotor/blades/flap/3", xplmType_Float, 0},
+    {"abb/rotor/blades/flap/4", xplmType_Float, 0},
+    {"abb/rotor/blades/lag/0", xplmType_Float, 0},
+    {"abb/rotor/blades/lag/1", xplmType_Float, 0},
+    {"abb/rotor/blades/lag/2", xplmType_Float, 0},
+    {"abb/rotor/blades/lag/3", xplmType_Float, 0},
+    {"abb/rotor/blades/lag/4", xplmType_Float, 0},
+    {"abb/rotor/blades/pitch/0", xplmType_Float, 1},
+    {"abb/rotor/blades/pitch/1", xplmType_Float, 1},
+    {"abb/rotor/blades/pitch/2", xplmType_Float, 1},
+    {"abb/rotor/blades/pitch/3", xplmType_Float, 1},
+    {"abb/rotor/blades/pitch/4", xplmType_Float, 1},
+    {"abb/rotor/disc/tilt/pitch/muting/low", xplmType_Float, 1},
+    {"abb/rotor/disc/tilt/roll/muting/low", xplmType_Float, 1},
+    {"abb/rotor/position/degrees/main", xplmType_Float, 1},
+    {"abb/rotor/position/degrees/main/muting", xplmType_Float, 1},
+    {"abb/rotor/position/degrees/tail", xplmType_Float, 1},
+    {"abb/rotor/position/degrees/tail/muting", xplmType_Float, 1},
+    {"abb/rotor/position/main/fps/muting", xplmType_Float, 1},
+    {"abb/rotor/position/tail/fps/muting", xplmType_Float, 1}
+};
 
 // global dataref variables
-static XPLMDataRef doorsLeftPositionDataRef = NULL, doorsRightPositionDataRef = NULL, adf1DataRef = NULL, adf2DataRef = NULL, com1DataRef = NULL, com2DataRef = NULL, dmeDataRef = NULL, nav1DataRef = NULL, nav2DataRef = NULL, tacradsHighMainDataRef = NULL, tacradsHighTailDataRef = NULL, headHeadingDataRef = NULL, rotorBladesPitch0DataRef = NULL, rotorBladesPitch1DataRef = NULL, rotorBladesPitch2DataRef = NULL, rotorBladesPitch3DataRef = NULL, rotorBladesPitch4DataRef = NULL, rotorMutingLowPitchDataRef = NULL, rotorMutingLowRollDataRef = NULL, rotorPositionMainDataRef = NULL, rotorPositionMainMutingDataRef = NULL, rotorPositionTailDataRef = NULL, rotorPositionTailMutingDataRef = NULL, rotorPositionMainFpsMutingDataRef = NULL, rotorPositionTailFpsMutingDataRef = NULL, acfNumBladesDataRef = NULL, acfCyclicAilnDataRef = NULL, acfCyclicElevDataRef = NULL, audioPanelOutDataRef = NULL, flaprqstDataRef = NULL, cyclicElevDiscTiltDataRef = NULL, cyclicAilnDiscTiltDataRef = NULL, pointPitchDegDataRef = NULL, pointTacradDataRef = NULL, ongroundAnyDataRef = NULL, localXDataRef = NULL, localZDataRef = NULL, phiDataRef = NULL, psiDataRef = NULL, pDotDataRef = NULL, qDotDataRef = NULL, viewXDataRef = NULL, viewZDataRef = NULL, yolkPitchRatioDataRef = NULL, yolkRollRatioDataRef = NULL, frameRatePeriodDataRef = NULL;
+static XPLMDataRef channelDataRefs[CHANNEL_COUNT];
+
+// define the number of aircraft that can be animated, the user's aircraft and
+// up to 19 AI or multiplayer aircraft
+#ifndef MAX_INSTANCES
+#define MAX_INSTANCES 20
+#endif
+
+// define blade limits
+#define MAX_BLADES 8
+#define BLADE_PITCH_CHANNELS (CHANNEL_ROTOR_BLADES_PITCH_4 - CHANNEL_ROTOR_BLADES_PITCH_0 + 1)
+
+typedef void (*BladePitchKernel_f)(float rotorPosition, float cyclicAiln, float cyclicElev, float collective, float *outPitch);
+
+// flap and lead-lag state of the blades of one instance in radians, with one
+// lane per blade so that all blades are integrated at once; the accumulator
+// holds the time not yet covered by a fixed step
+struct BladeDynamics
+{
+    alignas(32) float flap[MAX_BLADES];
+    alignas(32) float flapRate[MAX_BLADES];
+    alignas(32) float lag[MAX_BLADES];
+    alignas(32) float lagRate[MAX_BLADES];
+    float accumulator;
+    float tacrad;
+};
+
+// animation state of every animated aircraft, stored as structure of arrays
+// with one lane per instance so that the update functions can process all
+// instances in a single vectorizable pass
+// instance 0 is the user's aircraft, it is the only one published through
+// the channel datarefs
+// the doors play the track of their request, doorTime is the time on it and
+// doorCursor the segment it was last evaluated on; their channels hold the
+// position last evaluated and are out of date while doorStale is set
+struct InstanceState
+{
+    alignas(64) float channels[CHANNEL_COUNT][MAX_INSTANCES];
+    alignas(64) int doorCursor[MAX_INSTANCES];
+    alignas(64) float doorTime[MAX_INSTANCES];
+    alignas(64) float doorDuration[MAX_INSTANCES];
+    alignas(64) int doorOpen[MAX_INSTANCES];
+    alignas(64) int doorStale[MAX_INSTANCES];
+    int bladeCount[MAX_INSTANCES];
+    BladePitchKernel_f bladePitchKernel[MAX_INSTANCES];
+    BladeDynamics bladeDynamics[MAX_INSTANCES];
+    alignas(32) float bladeOffsetCos[MAX_INSTANCES][MAX_BLADES];
+    alignas(32) float bladeOffsetSin[MAX_INSTANCES][MAX_BLADES];
+};
+
+static InstanceState instances;
+static int instanceCount = 1;
+
+// define the name of the file next to the plugin that replaces the built-in
+// animation tracks, and the largest one that is read
+#define TRACKS_FILE "tracks.txt"
+#define MAX_TRACKS_FILE_SIZE 65536
+
+// built-in animation tracks, the doors swing open until they hit the stop and
+// bounce back a little, and speed up as they fall shut
+static const char *defaultTracks =
+    "track door_open\n"
+    "0.0000 0.00000 1.20000\n"
+    "0.2747 0.29589 0.96329\n"
+    "0.5493 0.53341 0.77327\n"
+    "0.8240 0.72408 0.62074\n"
+    "1.0986 0.87713 0.49829\n"
+    "1.3733 1.00000 0.40000\n"
+    "1.3733 1.00000 -0.10400\n"
+    "1.8611 0.95799 -0.07039\n"
+    "2.3490 0.92956 -0.04765\n"
+    "2.8369 0.91031 -0.03225\n"
+    "3.3248 0.89728 -0.02183\n"
+    "3.8126 0.88847 -0.01477\n"
+    "4.3005 0.88250 -0.01000\n"
+    "track door_close\n"
+    "0.0000 1.00000 -0.16000\n"
+    "0.2800 0.94979 -0.20017\n"
+    "0.5599 0.88698 -0.25041\n"
+    "0.8399 0.80841 -0.31328\n"
+    "1.1198 0.71010 -0.39192\n"
+    "1.3998 0.58712 -0.49030\n"
+    "1.6798 0.43327 -0.61339\n"
+    "1.9597 0.24079 -0.76737\n"
+    "2.2397 0.00000 -0.96000\n";
+
+// global track variables, the door tracks are indexed by whether the doors
+// are requested open
+static TrackTable trackTable;
+static int doorTracks[2];
+
+// compiles the tracks of a text into the track table if it is valid and has
+// every track the plugin plays, returns 0 and logs why otherwise
+static int CompileTracks(const char *text, const char *source)
+{
+    static TrackTable compiled;
+    char error[128];
+
+    int valid = TrackCompile(&compiled, text, error, sizeof(error));
+    if (valid && (TrackFind(&compiled, "door_close") < 0 || TrackFind(&compiled, "door_open") < 0))
+    {
+        snprintf(error, sizeof(error), "door_open or door_close missing");
+        valid = 0;
+    }
 
-// global internal variables
-int doorBounce = 0;
-float doorSpeed = 0.0f, doorsLeftPosition= 0.0f, doorsRightPosition= 0.0f, adf1= 0.0f, adf2= 0.0f, com1= 0.0f, com2= 0.0f, dme= 0.0f, nav1= 0.0f, nav2= 0.0f, tacradsHighMain= 0.0f, tacradsHighTail= 0.0f, headHeading= 0.0f, rotorBladesPitch0= 0.0f, rotorBladesPitch1= 0.0f, rotorBladesPitch2= 0.0f, rotorBladesPitch3= 0.0f, rotorBladesPitch4= 0.0f, rotorMutingLowPitch= 0.0f, rotorMutingLowRoll= 0.0f, rotorPositionMain= 0.0f, rotorPositionMainMuting= 0.0f, rotorPositionTail= 0.0f, rotorPositionTailMuting= 0.0f, rotorPositionMainFpsMuting= 0.0f, rotorPositionTailFpsMuting= 0.0f;
+    if (!valid)
+    {
+        char line[256 + 128];
+        snprintf(line, sizeof(line), NAME ": ignoring animation tracks in %s, %s\n", source, error);
+        XPLMDebugString(line);
+        return 0;
+    }
+
+    trackTable = compiled;
+    doorTracks[0] = TrackFind(&trackTable, "door_close");
+    doorTracks[1] = TrackFind(&trackTable, "door_open");
+
+    return 1;
+}
 
-static void UpdateDoors(void)
+// loads the animation tracks from a file, falling back to the built-in ones if
+// path is NULL or the file cannot be read or is not valid
+static void LoadTracks(const char *path)
 {
-    float frameRatePeriod = XPLMGetDataf(frameRatePeriodDataRef);
+    static char text[MAX_TRACKS_FILE_SIZE];
 
-    if(XPLMGetDataf(flaprqstDataRef) > 0.0f)
-    // doors open
+    FILE *file = path != NULL ? fopen(path, "rb") : NULL;
+    if (file != NULL)
     {
-        if(doorsLeftPosition < 1.0f && doorBounce == 0)
+        size_t size = fread(text, 1, sizeof(text) - 1, file);
+        int complete = feof(file) && !ferror(file);
+        fclose(file);
+        text[size] = '\0';
+
+        if (!complete)
         {
-            doorBounce = 0;
-            doorSpeed = MAX_DOOR_SPEED * (1.5f - doorsLeftPosition);
+            XPLMDebugString(NAME ": ignoring animation tracks in ");
+            XPLMDebugString(path);
+            XPLMDebugString(", the file cannot be read or is too large\n");
+        }
+        else if (CompileTracks(text, path))
+            return;
+    }
 
-            float newDoorPosition = doorsLeftPosition + doorSpeed * frameRatePeriod;
+    CompileTracks(defaultTracks, "the plugin");
+}
+
+// global flight loop variables
+static XPLMFlightLoopID shudderFlightLoop = NULL, frameFlightLoop = NULL, pilotFlightLoop = NULL, switchesFlightLoop = NULL, doorsFlightLoop = NULL;
+
+// define to 1 to start recording telemetry as soon as the plugin is enabled,
+// it can also be switched on and off at runtime through abb/telemetry/enabled
+#ifndef TELEMETRY_ENABLED
+#define TELEMETRY_ENABLED 0
+#endif
+
+// define telemetry parameters, the ring holds about a minute at 60 fps
+#define TELEMETRY_RING_RECORDS 4096
+#define TELEMETRY_MAGIC "ABBTLM"
+#define TELEMETRY_VERSION 8
+#define TELEMETRY_NAME_LENGTH 64
+
+// define overlay layout, the overlay samples the profiler every
+// OVERLAY_SAMPLE_INTERVAL seconds and keeps OVERLAY_HISTORY samples for the
+// sparkline
+#define OVERLAY_SAMPLE_INTERVAL 0.1
+#define OVERLAY_HISTORY 60
+#define OVERLAY_LINE_HEIGHT 14
+#define OVERLAY_PADDING 8
+#define OVERLAY_SPARKLINE_HEIGHT 40
+
+// profiled subsystems, frame covers the whole pass of single loop builds and
+// the handoff to the worker; only work done on the sim thread is profiled
+enum
+{
+    PROFILE_DOORS,
+    PROFILE_ROTOR,
+    PROFILE_PILOT,
+    PROFILE_SWITCHES,
+    PROFILE_SHUDDER,
+    PROFILE_FRAME,
+    PROFILE_COUNT
+};
+
+// statistics published for every profiled subsystem
+enum
+{
+    PROFILE_STAT_P50,
+    PROFILE_STAT_P99,
+    PROFILE_STAT_MAX,
+    PROFILE_STAT_COUNT
+};
+
+static const char *profileNames[PROFILE_COUNT] = {"doors", "rotor", "pilot", "switches", "shudder", "frame"};
+static const char *profileStatNames[PROFILE_STAT_COUNT] = {"p50_us", "p99_us", "max_us"};
+
+// consumed sim datarefs
+enum
+{
+    SIM_ACF_NUM_BLADES,
+    SIM_ACF_CYCLIC_AILN,
+    SIM_ACF_CYCLIC_ELEV,
+    SIM_AUDIO_PANEL_OUT,
+    SIM_FLAPRQST,
+    SIM_CYCLIC_ELEV_DISC_TILT,
+    SIM_CYCLIC_AILN_DISC_TILT,
+    SIM_POINT_PITCH_DEG,
+    SIM_POINT_TACRAD,
+    SIM_ONGROUND_ANY,
+    SIM_LOCAL_X,
+    SIM_LOCAL_Z,
+    SIM_PHI,
+    SIM_PSI,
+    SIM_P_DOT,
+    SIM_Q_DOT,
+    SIM_VIEW_X,
+    SIM_VIEW_Z,
+    SIM_YOLK_PITCH_RATIO,
+    SIM_YOLK_ROLL_RATIO,
+    SIM_FRAME_RATE_PERIOD,
+    SIM_DATAREF_COUNT
+};
+
+// describes a consumed sim dataref and the subsystems that cannot run without
+// it, as a mask of profiled subsystems; without scheduled updates a single
+// loop runs everything after the flight model and is skipped as a whole
+#if SCHEDULED_UPDATE
+#define SIM_DOORS (1u << PROFILE_DOORS)
+#define SIM_ROTOR (1u << PROFILE_ROTOR)
+#define SIM_PILOT (1u << PROFILE_PILOT)
+#define SIM_SWITCHES (1u << PROFILE_SWITCHES)
+#else
+#define SIM_DOORS (1u << PROFILE_FRAME)
+#define SIM_ROTOR (1u << PROFILE_FRAME)
+#define SIM_PILOT (1u << PROFILE_FRAME)
+#define SIM_SWITCHES (1u << PROFILE_FRAME)
+#endif
+#define SIM_SHUDDER (1u << PROFILE_SHUDDER)
+
+struct SimDataRefDescriptor
+{
+    const char *name;
+    uint32_t subsystems;
+};
+
+static const SimDataRefDescriptor simDataRefDescriptors[SIM_DATAREF_COUNT] =
+{
+    {"sim/aircraft/prop/acf_num_blades", SIM_ROTOR},
+    {"sim/aircraft/vtolcontrols/acf_cyclic_ailn", SIM_ROTOR},
+    {"sim/aircraft/vtolcontrols/acf_cyclic_elev", SIM_ROTOR},
+    {"sim/cockpit/switches/audio_panel_out", SIM_SWITCHES},
+    {"sim/flightmodel/controls/flaprqst", SIM_DOORS},
+    {"sim/flightmodel/cyclic/cyclic_elev_disc_tilt", SIM_ROTOR},
+    {"sim/flightmodel/cyclic/cyclic_ailn_disc_tilt", SIM_ROTOR},
+    {"sim/flightmodel/engine/POINT_pitch_deg", SIM_ROTOR},
+    {"sim/flightmodel/engine/POINT_tacrad", SIM_ROTOR | SIM_SHUDDER},
+    {"sim/flightmodel/failures/onground_any", SIM_PILOT | SIM_SHUDDER},
+    {"sim/flightmodel/position/local_x", SIM_PILOT},
+    {"sim/flightmodel/position/local_z", SIM_PILOT},
+    {"sim/flightmodel/position/phi", SIM_PILOT},
+    {"sim/flightmodel/position/psi", SIM_PILOT},
+    {"sim/flightmodel/position/P_dot", SIM_SHUDDER},
+    {"sim/flightmodel/position/Q_dot", SIM_SHUDDER},
+    {"sim/graphics/view/view_x", SIM_PILOT},
+    {"sim/graphics/view/view_z", SIM_PILOT},
+    {"sim/joystick/yolk_pitch_ratio", SIM_ROTOR},
+    {"sim/joystick/yolk_roll_ratio", SIM_ROTOR},
+    {"sim/operation/misc/frame_rate_period", SIM_ROTOR | SIM_DOORS}
+};
+
+// global sim dataref variables, the datarefs are looked up when the plugin is
+// enabled and checked again whenever the user's aircraft is loaded, subsystems
+// with a missing input are skipped until then
+static XPLMDataRef simDataRefs[SIM_DATAREF_COUNT];
+static uint32_t skippedSubsystems = 0;
+
+// global profiler variables
+static XPLMDataRef profilerEnabledDataRef = NULL, profileDataRefs[PROFILE_COUNT * PROFILE_STAT_COUNT];
+static int profilerEnabled = PROFILER;
+static ProfileClock profileClock;
+static ProfileHistogram profileHistograms[PROFILE_COUNT];
+
+// level of detail of the channels that cannot be seen from afar, chosen by the
+// distance of the camera from the user's aircraft once per frame
+enum
+{
+    LOD_FULL,
+    LOD_REDUCED,
+    LOD_FROZEN
+};
+
+// groups of channels with a level of detail
+enum
+{
+    LOD_SWITCHES,
+    LOD_PILOT,
+    LOD_BLADE_PITCH,
+    LOD_GROUP_COUNT
+};
+
+// camera distances in meters from which a group is reduced and frozen
+struct LodDescriptor
+{
+    float reducedDistance;
+    float frozenDistance;
+};
+
+// the audio panel flags can only be seen from the cockpit, so they go straight
+// from full to frozen; the pilot's head is turned at LOD_PILOT_INTERVAL while
+// reduced; the cyclic fades out of the blade pitch while reduced
+static const LodDescriptor lodDescriptors[LOD_GROUP_COUNT] =
+{
+    {4.0f, 4.0f},
+    {5.0f, 15.0f},
+    {30.0f, 150.0f}
+};
+
+// define the share of a distance that the camera has to move past it to leave
+// a level of detail, and the interval of the pilot while reduced
+#define LOD_HYSTERESIS 0.1f
+#define LOD_PILOT_INTERVAL 0.1f
+
+// define the frame rate the governor defends, while the smoothed frame period
+// stays above that of GOVERNOR_TARGET_FPS for GOVERNOR_SHED_TIME seconds it
+// sheds one more level of optional work, and once it has dropped below
+// GOVERNOR_RESTORE_RATIO of it for GOVERNOR_RESTORE_TIME seconds it restores
+// one; the frame period is smoothed with a time constant of
+// GOVERNOR_SMOOTHING_TIME seconds
+// the shudder and the disc tilt override are never shed
+#ifndef GOVERNOR_TARGET_FPS
+#define GOVERNOR_TARGET_FPS 30.0f
+#endif
+#define GOVERNOR_RESTORE_RATIO 0.85f
+#define GOVERNOR_SHED_TIME 1.0f
+#define GOVERNOR_RESTORE_TIME 3.0f
+#define GOVERNOR_SMOOTHING_TIME 0.5f
+#define GOVERNOR_LEVEL_COUNT 4
+
+// work done at a governor level: the pilot and switches intervals are
+// multiplied by their scales and the blade dynamics take steps that many
+// times as long
+struct GovernorLevel
+{
+    float pilotScale;
+    float switchesScale;
+    float bladeStepScale;
+};
+
+static const GovernorLevel governorLevels[GOVERNOR_LEVEL_COUNT] =
+{
+    {1.0f, 1.0f, 1.0f},
+    {2.0f, 2.0f, 1.0f},
+    {3.0f, 4.0f, 2.0f},
+    {3.0f, 8.0f, 4.0f}
+};
+
+// global governor variables, the level itself is a sim input
+static XPLMDataRef governorLevelDataRef = NULL;
+static float governorPeriod = 0.0f, governorTimer = 0.0f;
 
-            if (newDoorPosition > 1.0f)
-                newDoorPosition = 1.0f;
+// global internal variables
+static int doorsMoving = 0;
+static float doorsRequest[MAX_INSTANCES];
+
+// animation constants that can be tuned without rebuilding the plugin
+struct Tuning
+{
+    float doorSpeed;
+    float maxRotation;
+    float headRotationSpeed;
+    float headLimit;
+    float mutingTacrad;
+    float shudderGroundRoll;
+    float shudderGroundPitch;
+    float shudderRoll;
+    float shudderPitch;
+    float shudderFrequency;
+};
+
+static const Tuning defaultTuning =
+{
+    1.0f,       // doorSpeed, playback rate of the door tracks
+    720.0f,     // maxRotation, rotor positions wrap around at this many degrees
+    150.0f,     // headRotationSpeed, degrees per second at full deflection
+    70.0f,      // headLimit, degrees the pilot's head turns to either side
+    15.0f,      // mutingTacrad, main and tail rotor speed above which they are muted
+    0.001f,     // shudderGroundRoll, share of P_dot left on the ground
+    0.5f,       // shudderGroundPitch, share of Q_dot left on the ground
+    0.05f,      // shudderRoll, roll shudder per rad/s of main rotor speed
+    0.005f,     // shudderPitch, pitch shudder per rad/s of tail rotor speed
+    0.03f       // shudderFrequency, rate of the shudder per rad/s of the shudder inputs
+};
+
+// describes a line of the tuning file and the range it accepts
+struct TuningDescriptor
+{
+    const char *name;
+    size_t offset;
+    float min;
+    float max;
+};
+
+static const TuningDescriptor tuningDescriptors[] =
+{
+    {"door_speed", offsetof(Tuning, doorSpeed), 0.01f, 100.0f},
+    {"max_rotation", offsetof(Tuning, maxRotation), 360.0f, 36000.0f},
+    {"head_rotation_speed", offsetof(Tuning, headRotationSpeed), 0.0f, 3600.0f},
+    {"head_limit", offsetof(Tuning, headLimit), 0.0f, 180.0f},
+    {"muting_tacrad", offsetof(Tuning, mutingTacrad), 0.0f, 1000.0f},
+    {"shudder_ground_roll", offsetof(Tuning, shudderGroundRoll), 0.0f, 1.0f},
+    {"shudder_ground_pitch", offsetof(Tuning, shudderGroundPitch), 0.0f, 1.0f},
+    {"shudder_roll", offsetof(Tuning, shudderRoll), 0.0f, 10.0f},
+    {"shudder_pitch", offsetof(Tuning, shudderPitch), 0.0f, 10.0f},
+    {"shudder_frequency", offsetof(Tuning, shudderFrequency), 0.0f, 10.0f}
+};
+
+// snapshot of all sim datarefs consumed during one frame, along with the
+// tuning the frame runs with
+struct SimInputs
+{
+    Tuning tuning;
+    float frameRatePeriod;
+    float flaprqst;
+    float pointTacrad[8];
+    float pointPitchDeg;
+    float cyclicElevDiscTilt;
+    float cyclicAilnDiscTilt;
+    float acfNumBlades;
+    float acfCyclicAiln;
+    float acfCyclicElev;
+    float yolkPitchRatio;
+    float yolkRollRatio;
+    float localX;
+    float localZ;
+    float viewX;
+    float viewZ;
+    float phi;
+    float psi;
+    float pDot;
+    float qDot;
+    int ongroundAny;
+    int audioPanelOut;
+    float cameraDistance;
+    int32_t lodTiers[LOD_GROUP_COUNT];
+    int32_t governorLevel;
+};
+
+// sim datarefs written back during one frame
+struct SimOutputs
+{
+    float cyclicElevDiscTilt;
+    float cyclicAilnDiscTilt;
+    float pDot;
+    float qDot;
+};
+
+// sim inputs of every instance, one lane per instance like InstanceState
+struct InstanceInputs
+{
+    Tuning tuning;
+    float frameRatePeriod;
+    int32_t governorLevel;
+    alignas(64) float flaprqst[MAX_INSTANCES];
+    float pointTacrad[8][MAX_INSTANCES];
+    float pointPitchDeg[MAX_INSTANCES];
+    float cyclicElevDiscTilt[MAX_INSTANCES];
+    float cyclicAilnDiscTilt[MAX_INSTANCES];
+    float acfNumBlades[MAX_INSTANCES];
+    float acfCyclicAiln[MAX_INSTANCES];
+    float acfCyclicElev[MAX_INSTANCES];
+    float yolkPitchRatio[MAX_INSTANCES];
+    float yolkRollRatio[MAX_INSTANCES];
+    float localX[MAX_INSTANCES];
+    float localZ[MAX_INSTANCES];
+    float viewX[MAX_INSTANCES];
+    float viewZ[MAX_INSTANCES];
+    float phi[MAX_INSTANCES];
+    float psi[MAX_INSTANCES];
+    float pDot[MAX_INSTANCES];
+    float qDot[MAX_INSTANCES];
+    int ongroundAny[MAX_INSTANCES];
+    int audioPanelOut[MAX_INSTANCES];
+    float cameraDistance[MAX_INSTANCES];
+    int32_t bladePitchLod[MAX_INSTANCES];
+};
+
+// sim outputs of every instance, one lane per instance like InstanceState
+struct InstanceOutputs
+{
+    alignas(64) float cyclicElevDiscTilt[MAX_INSTANCES];
+    float cyclicAilnDiscTilt[MAX_INSTANCES];
+    float pDot[MAX_INSTANCES];
+    float qDot[MAX_INSTANCES];
+};
+
+static SimInputs simInputs;
+static InstanceInputs instanceInputs;
+static InstanceOutputs instanceOutputs;
+
+// puts every instance at rest with the doors closed and no blade pitch kernel
+// selected, the tracks have to be loaded
+static void ResetInstances(void)
+{
+    const Track *closed = &trackTable.tracks[doorTracks[0]];
+
+    memset(&instances, 0, sizeof(instances));
+    for (int i = 0; i < MAX_INSTANCES; i++)
+    {
+        instances.doorCursor[i] = closed->count - 1;
+        instances.doorTime[i] = closed->endTime;
+        instances.doorDuration[i] = closed->endTime;
+        instances.doorStale[i] = 1;
+        instances.bladeCount[i] = -1;
+    }
+}
 
-            doorsLeftPosition = newDoorPosition;
-            doorsRightPosition = newDoorPosition;
-        }
-        else
-        {
-            doorBounce = 1;
-            doorSpeed = MAX_DOOR_SPEED * (doorsLeftPosition - 0.87f);
+// stores the snapshot of one aircraft in the lane of an instance
+static void SetInstanceInputs(InstanceInputs *inputs, int instance, const SimInputs *snapshot)
+{
+    inputs->tuning = snapshot->tuning;
+    inputs->frameRatePeriod = snapshot->frameRatePeriod;
+    inputs->governorLevel = snapshot->governorLevel;
+    inputs->flaprqst[instance] = snapshot->flaprqst;
+    for (int i = 0; i < 8; i++)
+        inputs->pointTacrad[i][instance] = snapshot->pointTacrad[i];
+    inputs->pointPitchDeg[instance] = snapshot->pointPitchDeg;
+    inputs->cyclicElevDiscTilt[instance] = snapshot->cyclicElevDiscTilt;
+    inputs->cyclicAilnDiscTilt[instance] = snapshot->cyclicAilnDiscTilt;
+    inputs->acfNumBlades[instance] = snapshot->acfNumBlades;
+    inputs->acfCyclicAiln[instance] = snapshot->acfCyclicAiln;
+    inputs->acfCyclicElev[instance] = snapshot->acfCyclicElev;
+    inputs->yolkPitchRatio[instance] = snapshot->yolkPitchRatio;
+    inputs->yolkRollRatio[instance] = snapshot->yolkRollRatio;
+    inputs->localX[instance] = snapshot->localX;
+    inputs->localZ[instance] = snapshot->localZ;
+    inputs->viewX[instance] = snapshot->viewX;
+    inputs->viewZ[instance] = snapshot->viewZ;
+    inputs->phi[instance] = snapshot->phi;
+    inputs->psi[instance] = snapshot->psi;
+    inputs->pDot[instance] = snapshot->pDot;
+    inputs->qDot[instance] = snapshot->qDot;
+    inputs->ongroundAny[instance] = snapshot->ongroundAny;
+    inputs->audioPanelOut[instance] = snapshot->audioPanelOut;
+    inputs->cameraDistance[instance] = snapshot->cameraDistance;
+    inputs->bladePitchLod[instance] = snapshot->lodTiers[LOD_BLADE_PITCH];
+}
+
+// collects the outputs of one instance
+static void GetInstanceOutputs(const InstanceOutputs *outputs, int instance, SimOutputs *snapshot)
+{
+    snapshot->cyclicElevDiscTilt = outputs->cyclicElevDiscTilt[instance];
+    snapshot->cyclicAilnDiscTilt = outputs->cyclicAilnDiscTilt[instance];
+    snapshot->pDot = outputs->pDot[instance];
+    snapshot->qDot = outputs->qDot[instance];
+}
+
+// header at the start of a telemetry file, names the channels in record order
+struct TelemetryFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t recordSize;
+    uint32_t channelCount;
+    uint32_t referenceUpdate;
+    uint32_t trackChecksum;
+    char channelNames[CHANNEL_COUNT][TELEMETRY_NAME_LENGTH];
+};
+
+// state of one frame in a telemetry file, the sequence starts at 1 so that
+// the zeroed tail of a file that was not closed properly reads as its end,
+// gaps in the sequence are records dropped because the ring was full
+//
+// besides the results the record holds everything needed to replay the frame
+// exactly: the bit of every profiled subsystem that ran in stages together
+// with the time step it was given, the inputs read before the flight model
+// and the inputs the other subsystems had read by the end of the frame, and
+// the state that is not published, the door segment and the blade dynamics
+struct TelemetryRecord
+{
+    uint32_t sequence;
+    int32_t cycle;
+    float elapsedTime;
+    uint32_t stages;
+    float deltaTimes[PROFILE_COUNT];
+    float doorTime;
+    int32_t doorOpen;
+    SimInputs shudderInputs;
+    SimInputs inputs;
+    SimOutputs outputs;
+    float channels[CHANNEL_COUNT];
+    BladeDynamics bladeDynamics;
+};
+
+// global telemetry variables
+static XPLMDataRef telemetryEnabledDataRef = NULL, telemetryDroppedDataRef = NULL;
+static XPLMFlightLoopID telemetryFlightLoop = NULL;
+static int telemetryRequested = TELEMETRY_ENABLED;
+static uint32_t telemetrySequence = 0;
+static TelemetryRecord telemetryRecord;
+#if TELEMETRY
+static TelemetryWriter telemetryWriter;
+#endif
+
+// global worker variables, the worker is only started and stopped between
+// frames and workerRunning only changes on the sim thread
+static XPLMDataRef workerEnabledDataRef = NULL;
+static XPLMFlightLoopID workerFlightLoop = NULL;
+static int workerRequested = WORKER_ENABLED, workerRunning = 0;
+
+// define to 1 to start with the channels also published as shared data, it can
+// also be switched on and off at runtime through abb/share/enabled
+// every channel is shared under its name with abb/ replaced by SHARE_PREFIX,
+// the accessor datarefs keep their names, and a value is only set, and other
+// plugins only notified, at the end of a frame in which it has changed; the
+// shared data is read-only by convention, writes go through the accessors
+#ifndef SHARE_ENABLED
+#define SHARE_ENABLED 0
+#endif
+#define SHARE_PREFIX "abb/shared/"
+
+// global shared data variables
+static XPLMDataRef shareEnabledDataRef = NULL, sharedDataRefs[CHANNEL_COUNT];
+static XPLMFlightLoopID shareFlightLoop = NULL;
+static int shareRequested = SHARE_ENABLED;
+static float sharedValues[CHANNEL_COUNT];
+
+// define the name of the tuning file next to the plugin and the number of
+// seconds between checks whether it has changed
+#define TUNING_FILE "tuning.txt"
+#define TUNING_CHECK_INTERVAL 1.0f
+
+// global tuning variables, the tuning is only swapped on the sim thread
+static Tuning activeTuning = defaultTuning;
+#if TUNING
+static char tuningPath[512 + sizeof(TUNING_FILE)];
+static time_t tuningModified = 0;
+static off_t tuningSize = -1;
+static XPLMFlightLoopID tuningFlightLoop = NULL;
+#endif
+
+// notes in the telemetry record of the current frame that a subsystem ran, the
+// worker runs the frame from the same record
+inline static void RecordStage(int subsystem, float deltaTime)
+{
+    if (telemetryFlightLoop != NULL || workerRunning)
+    {
+        telemetryRecord.stages |= 1u << subsystem;
+        telemetryRecord.deltaTimes[subsystem] = deltaTime;
+    }
+}
 
-            if (doorSpeed < 0.01f)
-                doorSpeed = 0.0f;
+// starts timing a subsystem, returns 0 while the profiler is disabled
+inline static uint64_t ProfileBegin(void)
+{
+    return profilerEnabled ? ProfilerTicks() : 0;
+}
 
-            if (doorSpeed > 0.0f)
-            {
-                float newDoorPosition = doorsLeftPosition - doorSpeed * frameRatePeriod;
+// records the time since ProfileBegin for a subsystem
+inline static void ProfileEnd(int subsystem, uint64_t startTicks)
+{
+    if (profilerEnabled && startTicks != 0)
+        ProfilerRecord(&profileHistograms[subsystem], ProfilerTicks() - startTicks);
+}
 
-                if (newDoorPosition < 0.0f)
-                {
-                    newDoorPosition = 0.0f;
-                    doorBounce = 0;
-                }
+// writes the results of every subsystem that has been profiled to Log.txt
+static void DumpProfile(void)
+{
+    for (int i = 0; i < PROFILE_COUNT; i++)
+    {
+        const ProfileHistogram *histogram = &profileHistograms[i];
+        if (histogram->total == 0)
+            continue;
 
-                doorsLeftPosition = newDoorPosition;
-                doorsRightPosition = newDoorPosition;
-            }
-        }
+        char line[256];
+        snprintf(line, sizeof(line), NAME ": %s p50 %.2f us, p99 %.2f us, max %.2f us (last %u of %llu samples)\n", profileNames[i], ProfilerTicksToMicroseconds(&profileClock, ProfilerPercentile(histogram, 50.0)), ProfilerTicksToMicroseconds(&profileClock, ProfilerPercentile(histogram, 99.0)), ProfilerTicksToMicroseconds(&profileClock, ProfilerMax(histogram)), histogram->windows[0].count + histogram->windows[1].count, (unsigned long long) histogram->total);
+        XPLMDebugString(line);
     }
-    else
-    // doors closed
+}
+
+// reads the sim datarefs consumed by the transitional shudder
+static void ReadShudderInputs(SimInputs *inputs)
+{
+    XPLMGetDatavf(simDataRefs[SIM_POINT_TACRAD], inputs->pointTacrad, 0, 8);
+    inputs->pDot = XPLMGetDataf(simDataRefs[SIM_P_DOT]);
+    inputs->qDot = XPLMGetDataf(simDataRefs[SIM_Q_DOT]);
+    inputs->ongroundAny = XPLMGetDatai(simDataRefs[SIM_ONGROUND_ANY]);
+}
+
+// reads the sim datarefs consumed by the rotor
+static void ReadFrameInputs(SimInputs *inputs)
+{
+    inputs->frameRatePeriod = XPLMGetDataf(simDataRefs[SIM_FRAME_RATE_PERIOD]);
+    XPLMGetDatavf(simDataRefs[SIM_POINT_TACRAD], inputs->pointTacrad, 0, 8);
+    XPLMGetDatavf(simDataRefs[SIM_POINT_PITCH_DEG], &inputs->pointPitchDeg, 0, 1);
+    XPLMGetDatavf(simDataRefs[SIM_CYCLIC_ELEV_DISC_TILT], &inputs->cyclicElevDiscTilt, 0, 1);
+    XPLMGetDatavf(simDataRefs[SIM_CYCLIC_AILN_DISC_TILT], &inputs->cyclicAilnDiscTilt, 0, 1);
+    XPLMGetDatavf(simDataRefs[SIM_ACF_NUM_BLADES], &inputs->acfNumBlades, 0, 1);
+    inputs->acfCyclicAiln = XPLMGetDataf(simDataRefs[SIM_ACF_CYCLIC_AILN]);
+    inputs->acfCyclicElev = XPLMGetDataf(simDataRefs[SIM_ACF_CYCLIC_ELEV]);
+    inputs->yolkPitchRatio = XPLMGetDataf(simDataRefs[SIM_YOLK_PITCH_RATIO]);
+    inputs->yolkRollRatio = XPLMGetDataf(simDataRefs[SIM_YOLK_ROLL_RATIO]);
+}
+
+// reads the sim datarefs consumed by the pilot
+// the position of the aircraft has already been read for the level of detail
+static void ReadPilotInputs(SimInputs *inputs)
+{
+    inputs->viewX = XPLMGetDataf(simDataRefs[SIM_VIEW_X]);
+    inputs->viewZ = XPLMGetDataf(simDataRefs[SIM_VIEW_Z]);
+    inputs->phi = XPLMGetDataf(simDataRefs[SIM_PHI]);
+    inputs->psi = XPLMGetDataf(simDataRefs[SIM_PSI]);
+    inputs->ongroundAny = XPLMGetDatai(simDataRefs[SIM_ONGROUND_ANY]);
+}
+
+// reads the sim datarefs consumed by the switches
+static void ReadSwitchesInputs(SimInputs *inputs)
+{
+    inputs->audioPanelOut = XPLMGetDatai(simDataRefs[SIM_AUDIO_PANEL_OUT]);
+}
+
+// reads the position of the camera and the aircraft, once per frame before
+// any other subsystem, the camera is at the aircraft if its position is missing
+static void ReadLodInputs(SimInputs *inputs)
+{
+    if (simDataRefs[SIM_LOCAL_X] == NULL || simDataRefs[SIM_LOCAL_Z] == NULL)
     {
-        doorBounce = 0;
-        doorSpeed = MAX_DOOR_SPEED * (1.2f - doorsLeftPosition);
+        inputs->cameraDistance = 0.0f;
+        return;
+    }
 
-        if (doorsLeftPosition > 0.0f)
-        {
-            float newDoorPosition = doorsLeftPosition - doorSpeed * frameRatePeriod;
-            if (newDoorPosition < 0.0f)
-                newDoorPosition = 0.0f;
+    XPLMCameraPosition_t camera;
+    XPLMReadCameraPosition(&camera);
+    inputs->localX = XPLMGetDataf(simDataRefs[SIM_LOCAL_X]);
+    inputs->localZ = XPLMGetDataf(simDataRefs[SIM_LOCAL_Z]);
 
-            doorsLeftPosition = newDoorPosition;
-            doorsRightPosition = newDoorPosition;
-        }
+    float deltaX = camera.x - inputs->localX;
+    float deltaZ = camera.z - inputs->localZ;
+    inputs->cameraDistance = sqrtf(deltaX * deltaX + deltaZ * deltaZ);
+}
+
+// reads the door request, the frame loop wakes the doors up with it
+static void ReadDoorsRequest(SimInputs *inputs)
+{
+    inputs->flaprqst = XPLMGetDataf(simDataRefs[SIM_FLAPRQST]);
+}
+
+// reads the sim datarefs consumed by the doors
+static void ReadDoorsInputs(SimInputs *inputs)
+{
+    inputs->frameRatePeriod = XPLMGetDataf(simDataRefs[SIM_FRAME_RATE_PERIOD]);
+    ReadDoorsRequest(inputs);
+}
+
+// reads every sim dataref consumed after the flight model exactly once
+static void ReadSimInputs(SimInputs *inputs)
+{
+    ReadFrameInputs(inputs);
+    ReadPilotInputs(inputs);
+    ReadSwitchesInputs(inputs);
+    ReadDoorsRequest(inputs);
+}
+
+// writes the transitional shudder of the user's aircraft back to the sim,
+// before the flight model integrates the angular accelerations
+static void WriteShudderOutputs(const InstanceOutputs *outputs)
+{
+    XPLMSetDataf(simDataRefs[SIM_P_DOT], outputs->pDot[0]);
+    XPLMSetDataf(simDataRefs[SIM_Q_DOT], outputs->qDot[0]);
+}
+
+// writes the disc tilt of the user's aircraft back to the sim, after the
+// flight model has computed it so that the override is what gets drawn
+static void WriteRotorOutputs(const InstanceOutputs *outputs)
+{
+    XPLMSetDatavf(simDataRefs[SIM_CYCLIC_ELEV_DISC_TILT], (float *) &outputs->cyclicElevDiscTilt[0], 0, 1);
+    XPLMSetDatavf(simDataRefs[SIM_CYCLIC_AILN_DISC_TILT], (float *) &outputs->cyclicAilnDiscTilt[0], 0, 1);
+}
+
+// the Step* functions advance a subsystem for a single instance, the loops over
+// all instances in the Update* functions and the fused kernel are meant to be
+// vectorized, so they only branch where the compiler can turn the branch into
+// selects: every condition is tested once, assigning locals that are stored
+// unconditionally afterwards
+
+// position of the doors of an instance on the track of their request
+static float DoorPosition(int i)
+{
+    return TrackEvaluate(&trackTable, doorTracks[instances.doorOpen[i]], instances.doorTime[i], &instances.doorCursor[i]);
+}
+
+// puts the doors of an instance on the track of a request where it first
+// reaches position, so that they carry on from there without a jump
+static void SeekDoors(int i, int open, float position)
+{
+    int track = doorTracks[open];
+
+    instances.doorOpen[i] = open;
+    instances.doorTime[i] = TrackSeek(&trackTable, track, position, &instances.doorCursor[i]);
+    instances.doorDuration[i] = trackTable.tracks[track].endTime;
+    instances.doorStale[i] = 1;
+}
+
+// moves the doors of an instance onto the other track if its request flipped,
+// this is the only part of stepping the doors that evaluates a track, and it
+// only does so when the request flips
+inline static void BeginDoors(const InstanceInputs *__restrict inputs, int i)
+{
+    int open = inputs->flaprqst[i] > 0.0f;
+    if (open != instances.doorOpen[i])
+        SeekDoors(i, open, DoorPosition(i));
+}
+
+// advances the doors of an instance along their track, returns 0 once they
+// have come to rest
+inline static int AdvanceDoors(float deltaTime, int i)
+{
+    float time = instances.doorTime[i];
+    float duration = instances.doorDuration[i];
+    float advanced = time + deltaTime;
+    advanced = advanced < duration ? advanced : duration;
+
+    instances.doorTime[i] = advanced;
+    instances.doorStale[i] |= advanced != time;
+
+    return advanced < duration;
+}
+
+// advances the doors of an instance by deltaTime seconds, returns 0 once they
+// have come to rest
+inline static int StepDoors(const InstanceInputs *__restrict inputs, float deltaTime, int i)
+{
+    BeginDoors(inputs, i);
+
+    return AdvanceDoors(deltaTime * inputs->tuning.doorSpeed, i);
+}
+
+// advances the doors of all instances by deltaTime seconds, returns 0 once they
+// have all come to rest
+// the flips are handled in a separate pass so that advancing stays vectorizable
+static int UpdateDoors(const InstanceInputs *__restrict inputs, float deltaTime, int count)
+{
+    int moving = 0;
+
+    for (int i = 0; i < count; i++)
+        BeginDoors(inputs, i);
+
+    float trackTime = deltaTime * inputs->tuning.doorSpeed;
+    for (int i = 0; i < count; i++)
+        moving |= AdvanceDoors(trackTime, i);
+
+    return moving;
+}
+
+// reads a channel of an instance, the doors are only evaluated here and only
+// if they have moved on since they were last read
+static float GetChannel(int channel, int i)
+{
+    if ((channel == CHANNEL_DOORS_LEFT_POSITION || channel == CHANNEL_DOORS_RIGHT_POSITION) && instances.doorStale[i])
+    {
+        float position = DoorPosition(i);
+        instances.channels[CHANNEL_DOORS_LEFT_POSITION][i] = position;
+        instances.channels[CHANNEL_DOORS_RIGHT_POSITION][i] = position;
+        instances.doorStale[i] = 0;
     }
+
+    return instances.channels[channel][i];
+}
+
+// writes a channel of an instance, both doors jump to where their track
+// reaches a position written to either of them, clamped to their travel
+static void SetChannel(int channel, int i, float value)
+{
+    if (channel == CHANNEL_DOORS_LEFT_POSITION || channel == CHANNEL_DOORS_RIGHT_POSITION)
+    {
+        value = value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+        SeekDoors(i, instances.doorOpen[i], value);
+        instances.channels[CHANNEL_DOORS_LEFT_POSITION][i] = value;
+        instances.channels[CHANNEL_DOORS_RIGHT_POSITION][i] = value;
+        instances.doorStale[i] = 0;
+        return;
+    }
+
+    instances.channels[channel][i] = value;
 }
 
 // converts from degrees to radians
@@ -107,49 +1113,337 @@ inline static double RadiansToDegress(double radians)
     return radians * (180.0 / M_PI);
 }
 
-// converts from degrees to radians
-inline static double DegreesToRadians(double degrees)
+// sine of an angle in radians, usable in constant expressions
+constexpr double ConstexprSin(double radians)
 {
-    return degrees * (M_PI / 180.0);
+    while (radians > M_PI)
+        radians -= 2.0 * M_PI;
+    while (radians < -M_PI)
+        radians += 2.0 * M_PI;
+
+    double term = radians, sum = radians;
+    for (int n = 1; n < 12; n++)
+    {
+        term *= -radians * radians / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+
+    return sum;
 }
 
-static void UpdateRotor(void)
+constexpr double ConstexprCos(double radians)
 {
-    float pointTacrad[8];
-    XPLMGetDatavf(pointTacradDataRef, pointTacrad, 0, 8);
+    return ConstexprSin(radians + M_PI / 2.0);
+}
 
-    float frameRatePeriod = XPLMGetDataf(frameRatePeriodDataRef);
+// rotation of each blade relative to the first one, computed at compile time
+template <int BladeCount>
+struct BladeOffsets
+{
+    float cosines[BladeCount];
+    float sines[BladeCount];
 
-    // main rotor
-    float v1 = XPLMGetDataf(rotorPositionMainDataRef) + RadiansToDegress(pointTacrad[0]) * frameRatePeriod;
-    if (v1 > MAX_ROTATION )
-        v1 -= MAX_ROTATION;
-    else if (v1 < -MAX_ROTATION)
-        v1 += MAX_ROTATION;
-    rotorPositionMain = v1;
+    constexpr BladeOffsets() : cosines(), sines()
+    {
+        for (int i = 0; i < BladeCount; i++)
+        {
+            cosines[i] = (float) ConstexprCos(i * 2.0 * M_PI / BladeCount);
+            sines[i] = (float) ConstexprSin(i * 2.0 * M_PI / BladeCount);
+        }
+    }
+};
+
+// computes the cyclic pitch of BladeCount evenly spaced blades for the main
+// rotor at rotorPosition degrees
+// the blade spacing is a compile time constant, so only the sine and cosine
+// of the first blade's azimuth are evaluated at runtime, the other blades are
+// rotated with the angle addition formulas over constant offsets, and the
+// loops have constant trip counts that the compiler unrolls completely
+// blades beyond the published pitch channels are not computed at all
+// outPitch points at the first pitch channel of an instance, the channels of
+// the following blades are MAX_INSTANCES lanes apart
+template <int BladeCount>
+static void ComputeBladePitch(float rotorPosition, float cyclicAiln, float cyclicElev, float collective, float *outPitch)
+{
+    constexpr float bladeOffsetStep = 360.0f / BladeCount;
+    constexpr int publishedBlades = BladeCount < BLADE_PITCH_CHANNELS ? BladeCount : BLADE_PITCH_CHANNELS;
+    static constexpr BladeOffsets<BladeCount> offsets;
+    const float degreesToRadians = (float) (M_PI / 180.0);
+
+    float baseSin, baseCos;
+    MathSinCos((rotorPosition - bladeOffsetStep * 0.5f) * degreesToRadians, &baseSin, &baseCos);
+
+    for (int i = 0; i < publishedBlades; i++)
+    {
+        float bladeCos = baseCos * offsets.cosines[i] - baseSin * offsets.sines[i];
+        float bladeSin = baseSin * offsets.cosines[i] + baseCos * offsets.sines[i];
 
-    // tail rotor
-    float v2 = XPLMGetDataf(rotorPositionTailDataRef) + RadiansToDegress(pointTacrad[1]) * frameRatePeriod;
-    if (v2 > MAX_ROTATION )
-        v2 -= MAX_ROTATION;
-    else if (v2 < -MAX_ROTATION)
-        v2 += MAX_ROTATION;
-    rotorPositionTail = v2;
+        outPitch[i * MAX_INSTANCES] = collective - (cyclicAiln * bladeCos - cyclicElev * bladeSin);
+    }
+}
+
+// blade pitch kernels indexed by blade count
+static const BladePitchKernel_f bladePitchKernels[MAX_BLADES + 1] =
+{
+    NULL,
+    ComputeBladePitch<1>,
+    ComputeBladePitch<2>,
+    ComputeBladePitch<3>,
+    ComputeBladePitch<4>,
+    ComputeBladePitch<5>,
+    ComputeBladePitch<6>,
+    ComputeBladePitch<7>,
+    ComputeBladePitch<8>
+};
+
+// switches an instance to the kernel for a new blade count, spaces the blades
+// for the blade dynamics and clears the channels of blades that no longer
+// exist
+static void SelectBladePitchKernel(int instance, int newBladeCount)
+{
+    instances.bladeCount[instance] = newBladeCount;
+
+    int kernelIndex = newBladeCount < 0 ? 0 : newBladeCount > MAX_BLADES ? MAX_BLADES : newBladeCount;
+    instances.bladePitchKernel[instance] = bladePitchKernels[kernelIndex];
+
+    // blades beyond the blade count are integrated along with the others but
+    // never published
+    for (int i = 0; i < MAX_BLADES; i++)
+    {
+        float offsetSin = 0.0f, offsetCos = 0.0f;
+        if (i < kernelIndex)
+            MathSinCos(i * (float) (2.0 * M_PI) / kernelIndex, &offsetSin, &offsetCos);
 
-    float cyclicElevDiscTilt = 0.0f;
-    XPLMGetDatavf(cyclicElevDiscTiltDataRef, &cyclicElevDiscTilt, 0, 1);
-    float cyclicAilnDiscTilt = 0.0f;
-    XPLMGetDatavf(cyclicAilnDiscTiltDataRef, &cyclicAilnDiscTilt, 0, 1);
+        instances.bladeOffsetCos[instance][i] = offsetCos;
+        instances.bladeOffsetSin[instance][i] = offsetSin;
+    }
+
+    for (int i = kernelIndex; i < BLADE_PITCH_CHANNELS; i++)
+    {
+        instances.channels[CHANNEL_ROTOR_BLADES_PITCH_0 + i][instance] = 0.0f;
+        instances.channels[CHANNEL_ROTOR_BLADES_FLAP_0 + i][instance] = 0.0f;
+        instances.channels[CHANNEL_ROTOR_BLADES_LAG_0 + i][instance] = 0.0f;
+    }
+    if (kernelIndex == 0)
+        instances.channels[CHANNEL_ROTOR_BLADES_CONING][instance] = 0.0f;
+}
+
+// share of the cyclic in the blade pitch at a camera distance, fading out
+// across the reduced level of detail and already gone where the pitch is frozen
+// or unfrozen, so that neither of them makes the blades jump
+inline static float BladePitchDetail(float distance)
+{
+    const LodDescriptor *lod = &lodDescriptors[LOD_BLADE_PITCH];
+    float fadeEnd = lod->frozenDistance * (1.0f - LOD_HYSTERESIS);
+    float detail = (fadeEnd - distance) / (fadeEnd - lod->reducedDistance);
+
+    return detail > 1.0f ? 1.0f : detail < 0.0f ? 0.0f : detail;
+}
+
+// computes the blade pitch of all instances at their current rotor position,
+// the kernel is selected per instance so this stays outside the vector loops
+static void UpdateBladePitch(const InstanceInputs *inputs, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        int newBladeCount = (int) inputs->acfNumBlades[i];
+        if (newBladeCount != instances.bladeCount[i])
+            SelectBladePitchKernel(i, newBladeCount);
+
+        BladePitchKernel_f bladePitchKernel = instances.bladePitchKernel[i];
+        if (bladePitchKernel == NULL || inputs->bladePitchLod[i] == LOD_FROZEN)
+            continue;
+
+        float detail = BladePitchDetail(inputs->cameraDistance[i]);
+        bladePitchKernel(instances.channels[CHANNEL_ROTOR_POSITION_MAIN][i], inputs->acfCyclicAiln[i] * inputs->yolkRollRatio[i] * detail, inputs->acfCyclicElev[i] * inputs->yolkPitchRatio[i] * detail, inputs->pointPitchDeg[i], &instances.channels[CHANNEL_ROTOR_BLADES_PITCH_0][i]);
+    }
+}
+
+// define blade dynamics parameters, the blades are integrated in fixed steps
+// of BLADE_STEP seconds, or a multiple of it set by the governor, and a frame
+// runs at most BLADE_MAX_STEPS of them, the time beyond that is dropped
+// the flap and lag frequencies are in multiples of the rotor speed, the
+// stiffness and damping terms hold the blades while the rotor is stopped;
+// gravity pulls the blades down onto the droop stop at low rpm, at flight rpm
+// the coning settles where lift and centrifugal force balance
+#define BLADE_STEP (1.0f / 240.0f)
+#define BLADE_MAX_STEPS 16
+#define BLADE_LOCK_NUMBER 6.0f
+#define BLADE_FLAP_FREQUENCY 1.03f
+#define BLADE_FLAP_STIFFNESS 4.0f
+#define BLADE_FLAP_DAMPING 1.0f
+#define BLADE_DROOP_ACCELERATION 3.7f
+#define BLADE_DROOP_STOP -0.05f
+#define BLADE_LAG_FREQUENCY 0.3f
+#define BLADE_LAG_STIFFNESS 4.0f
+#define BLADE_LAG_DAMPING 6.0f
+#define BLADE_PROFILE_DRAG 0.002f
+#define BLADE_INDUCED_DRAG 0.02f
+#define BLADE_LAG_INERTIA 0.25f
+#define BLADE_LAG_STOP 0.2f
+
+// integrates the flap and lead-lag of the blades of an instance over the
+// frame and publishes them, together with the coning, in degrees
+// the blade pitch is evaluated at every step at the azimuth the blade had at
+// that time, so the cyclic drives the flapping once per revolution; all blades
+// are stepped together in the lanes of the inner loop, positive lag trails the
+// blade's rotation
+inline static void StepBladeDynamics(const InstanceInputs *__restrict inputs, int i)
+{
+    const float degreesToRadians = (float) (M_PI / 180.0);
+    const float radiansToDegrees = (float) (180.0 / M_PI);
+
+    int bladeCount = instances.bladeCount[i];
+    if (bladeCount <= 0)
+        return;
+    bladeCount = bladeCount > MAX_BLADES ? MAX_BLADES : bladeCount;
+
+    BladeDynamics *blades = &instances.bladeDynamics[i];
+    const float *offsetCos = instances.bladeOffsetCos[i];
+    const float *offsetSin = instances.bladeOffsetSin[i];
+
+    float frameRatePeriod = inputs->frameRatePeriod;
+    float tacrad = inputs->pointTacrad[0][i];
+    float tacradRate = frameRatePeriod > 0.0f ? (tacrad - blades->tacrad) / frameRatePeriod : 0.0f;
+    blades->tacrad = tacrad;
+
+    // the governor lengthens the steps under load, which stays stable for the
+    // stiffest blade up to four times the step
+    float bladeStep = BLADE_STEP * governorLevels[inputs->governorLevel].bladeStepScale;
+    float elapsed = blades->accumulator + frameRatePeriod;
+    int steps = (int) (elapsed / bladeStep);
+    steps = steps > BLADE_MAX_STEPS ? BLADE_MAX_STEPS : steps;
+    float remaining = elapsed - steps * bladeStep;
+    blades->accumulator = remaining < bladeStep ? remaining : 0.0f;
+
+    // azimuth of every blade at the start of the first step, the rotor
+    // position is that of the end of the frame
+    float baseSin, baseCos, stepSin, stepCos;
+    MathSinCos((instances.channels[CHANNEL_ROTOR_POSITION_MAIN][i] - 180.0f / bladeCount) * degreesToRadians - tacrad * elapsed, &baseSin, &baseCos);
+    MathSinCos(tacrad * bladeStep, &stepSin, &stepCos);
+
+    alignas(32) float azimuthCos[MAX_BLADES];
+    alignas(32) float azimuthSin[MAX_BLADES];
+    for (int b = 0; b < MAX_BLADES; b++)
+    {
+        azimuthCos[b] = baseCos * offsetCos[b] - baseSin * offsetSin[b];
+        azimuthSin[b] = baseSin * offsetCos[b] + baseCos * offsetSin[b];
+    }
+
+    float collective = inputs->pointPitchDeg[i] * degreesToRadians;
+    float cyclicAiln = inputs->acfCyclicAiln[i] * inputs->yolkRollRatio[i] * degreesToRadians;
+    float cyclicElev = inputs->acfCyclicElev[i] * inputs->yolkPitchRatio[i] * degreesToRadians;
+
+    float tacradSquared = tacrad * tacrad;
+    float lockTerm = BLADE_LOCK_NUMBER / 8.0f;
+    float flapForcing = lockTerm * tacradSquared;
+    float flapDamping = lockTerm * fabsf(tacrad) + BLADE_FLAP_DAMPING;
+    float flapStiffness = BLADE_FLAP_FREQUENCY * BLADE_FLAP_FREQUENCY * tacradSquared + BLADE_FLAP_STIFFNESS;
+    float lagForcing = BLADE_LAG_INERTIA * tacradRate;
+    float lagStiffness = BLADE_LAG_FREQUENCY * BLADE_LAG_FREQUENCY * tacradSquared + BLADE_LAG_STIFFNESS;
+
+    for (int step = 0; step < steps; step++)
+    {
+        for (int b = 0; b < MAX_BLADES; b++)
+        {
+            float pitch = collective - (cyclicAiln * azimuthCos[b] - cyclicElev * azimuthSin[b]);
+            float flap = blades->flap[b];
+            float flapRate = blades->flapRate[b];
+            float lag = blades->lag[b];
+            float lagRate = blades->lagRate[b];
+
+            // drag and spin-up pull the blade back, flapping up moves its mass
+            // inwards and pushes it forward
+            float flapAcceleration = flapForcing * pitch - BLADE_DROOP_ACCELERATION - flapDamping * flapRate - flapStiffness * flap;
+            float lagAcceleration = (BLADE_PROFILE_DRAG + BLADE_INDUCED_DRAG * fabsf(pitch)) * tacradSquared + lagForcing - 2.0f * tacrad * flap * flapRate - BLADE_LAG_DAMPING * lagRate - lagStiffness * lag;
+
+            // semi-implicit euler, the rates are advanced first
+            flapRate += flapAcceleration * bladeStep;
+            flap += flapRate * bladeStep;
+            lagRate += lagAcceleration * bladeStep;
+            lag += lagRate * bladeStep;
+
+            // the stops take up the motion into them
+            if (flap < BLADE_DROOP_STOP)
+            {
+                flap = BLADE_DROOP_STOP;
+                flapRate = flapRate < 0.0f ? 0.0f : flapRate;
+            }
+
+            float lagLimit = lag < -BLADE_LAG_STOP ? -BLADE_LAG_STOP : lag;
+            lagLimit = lagLimit > BLADE_LAG_STOP ? BLADE_LAG_STOP : lagLimit;
+            lagRate = lagLimit != lag ? 0.0f : lagRate;
+
+            blades->flap[b] = flap;
+            blades->flapRate[b] = flapRate;
+            blades->lag[b] = lagLimit;
+            blades->lagRate[b] = lagRate;
+
+            float nextCos = azimuthCos[b] * stepCos - azimuthSin[b] * stepSin;
+            float nextSin = azimuthSin[b] * stepCos + azimuthCos[b] * stepSin;
+            azimuthCos[b] = nextCos;
+            azimuthSin[b] = nextSin;
+        }
+    }
+
+    float coning = 0.0f;
+    for (int b = 0; b < MAX_BLADES; b++)
+        coning += b < bladeCount ? blades->flap[b] : 0.0f;
+    instances.channels[CHANNEL_ROTOR_BLADES_CONING][i] = coning / bladeCount * radiansToDegrees;
 
-    float newCyclicElevDiscTilt = 0.0f;
-    float newCyclicAilnDiscTilt = 0.0f;
-    float newRotorMutingLowPitch = 0.0f;
-    float newRotorMutingLowRoll = 0.0f;
+    int publishedBlades = bladeCount < BLADE_PITCH_CHANNELS ? bladeCount : BLADE_PITCH_CHANNELS;
+    for (int b = 0; b < publishedBlades; b++)
+    {
+        instances.channels[CHANNEL_ROTOR_BLADES_FLAP_0 + b][i] = blades->flap[b] * radiansToDegrees;
+        instances.channels[CHANNEL_ROTOR_BLADES_LAG_0 + b][i] = blades->lag[b] * radiansToDegrees;
+    }
+}
+
+// integrates the blade dynamics of all instances over the frame, after their
+// blade count has been checked by UpdateBladePitch
+static void UpdateBladeDynamics(const InstanceInputs *__restrict inputs, int count)
+{
+    for (int i = 0; i < count; i++)
+        StepBladeDynamics(inputs, i);
+}
+
+// advances the rotors of an instance by one frame, without the blade pitch and
+// dynamics
+inline static void StepRotor(const InstanceInputs *__restrict inputs, InstanceOutputs *__restrict outputs, int i)
+{
+    float (*channels)[MAX_INSTANCES] = instances.channels;
+    float frameRatePeriod = inputs->frameRatePeriod;
+    float maxRotation = inputs->tuning.maxRotation;
+    float mutingTacrad = inputs->tuning.mutingTacrad;
+    float tacradMain = inputs->pointTacrad[0][i];
+    float tacradTail = inputs->pointTacrad[1][i];
 
-    if (pointTacrad[0] >= 15.0f)
+    // main rotor
+    float v1 = channels[CHANNEL_ROTOR_POSITION_MAIN][i] + RadiansToDegress(tacradMain) * frameRatePeriod;
+    v1 = v1 > maxRotation ? v1 - maxRotation : v1 < -maxRotation ? v1 + maxRotation : v1;
+    channels[CHANNEL_ROTOR_POSITION_MAIN][i] = v1;
+
+    // tail rotor
+    float v2 = channels[CHANNEL_ROTOR_POSITION_TAIL][i] + RadiansToDegress(tacradTail) * frameRatePeriod;
+    v2 = v2 > maxRotation ? v2 - maxRotation : v2 < -maxRotation ? v2 + maxRotation : v2;
+    channels[CHANNEL_ROTOR_POSITION_TAIL][i] = v2;
+
+    float cyclicElevDiscTilt = inputs->cyclicElevDiscTilt[i];
+    float cyclicAilnDiscTilt = inputs->cyclicAilnDiscTilt[i];
+    float rotorPositionMainMuting = channels[CHANNEL_ROTOR_POSITION_MAIN_MUTING][i];
+
+    // fps based accumulators
+    float fpsAccMain = channels[CHANNEL_ROTOR_POSITION_MAIN_FPS_MUTING][i];
+    fpsAccMain = fpsAccMain > 36000.0f ? fpsAccMain - 36000.0f : fpsAccMain;
+    float fpsAccTail = channels[CHANNEL_ROTOR_POSITION_TAIL_FPS_MUTING][i];
+    fpsAccTail = fpsAccTail > 36000.0f ? fpsAccTail - 36000.0f : fpsAccTail;
+
+    float tacradsHighMain, newCyclicElevDiscTilt, newCyclicAilnDiscTilt, newRotorMutingLowPitch, newRotorMutingLowRoll;
+    if (tacradMain >= mutingTacrad)
     {
         tacradsHighMain = 1.0f;
-        // TODO: XPLMSetDataf(xcdr_rotorPositionDegressMainMuted, 0.0f);
+        rotorPositionMainMuting = 0.0f;
+        fpsAccMain += 36.0f;
 
         // low speed rotor
         newCyclicElevDiscTilt = 0.0f;
@@ -158,19 +1452,11 @@ static void UpdateRotor(void)
         // high speed rotor
         newRotorMutingLowPitch = cyclicElevDiscTilt;
         newRotorMutingLowRoll = cyclicAilnDiscTilt;
-
-        // fps based accumulators
-        float fpsAccMain = XPLMGetDataf(rotorPositionMainFpsMutingDataRef);
-        if (fpsAccMain > 36000.0f)
-            fpsAccMain -= 36000.0f;
-
-        rotorPositionMainFpsMuting = fpsAccMain + 36.0f;
-        rotorPositionMainMuting = 0.0f;
     }
     else
     {
         tacradsHighMain = 0.0f;
-        rotorPositionMainFpsMuting = v1;
+        fpsAccMain = 0.0f;
 
         // low speed rotor
         newCyclicElevDiscTilt = cyclicElevDiscTilt;
@@ -179,517 +1465,1402 @@ static void UpdateRotor(void)
         // high speed rotor
         newRotorMutingLowPitch = 0.0f;
         newRotorMutingLowRoll = 0.0f;
-
-        rotorPositionMainFpsMuting = 0.0f;
     }
 
-    XPLMSetDataf(cyclicElevDiscTiltDataRef, newCyclicElevDiscTilt);
-    XPLMSetDataf(cyclicAilnDiscTiltDataRef, newCyclicAilnDiscTilt);
-    rotorMutingLowPitch = newRotorMutingLowPitch;
-    rotorMutingLowRoll = newRotorMutingLowRoll;
-
-    if (pointTacrad[1] >= 15.0f)
+    float tacradsHighTail, rotorPositionTailMuting;
+    if (tacradTail >= mutingTacrad)
     {
         tacradsHighTail = 1.0f;
         rotorPositionTailMuting = 0.0f;
-
-        // fps based accumulators
-        float fpsAccTail = rotorPositionTailFpsMuting;
-        if( fpsAccTail > 36000.0f)
-            fpsAccTail -= 36000.0f;
-        rotorPositionTailFpsMuting = fpsAccTail + 36.0f;
+        fpsAccTail += 36.0f;
     }
     else
     {
         tacradsHighTail = 0.0f;
         rotorPositionTailMuting = v2;
-        rotorPositionTailFpsMuting = 0.0f;
+        fpsAccTail = 0.0f;
     }
 
-    float acfNumBlades = 0.0f;
-    XPLMGetDatavf(acfNumBladesDataRef, &acfNumBlades, 0, 1);
-    if (acfNumBlades > 5.0f)
-        acfNumBlades = 5.0f;
+    channels[CHANNEL_TACRADS_HIGH_MAIN][i] = tacradsHighMain;
+    channels[CHANNEL_ROTOR_POSITION_MAIN_MUTING][i] = rotorPositionMainMuting;
+    channels[CHANNEL_ROTOR_POSITION_MAIN_FPS_MUTING][i] = fpsAccMain;
+    channels[CHANNEL_ROTOR_MUTING_LOW_PITCH][i] = newRotorMutingLowPitch;
+    channels[CHANNEL_ROTOR_MUTING_LOW_ROLL][i] = newRotorMutingLowRoll;
+    outputs->cyclicElevDiscTilt[i] = newCyclicElevDiscTilt;
+    outputs->cyclicAilnDiscTilt[i] = newCyclicAilnDiscTilt;
+
+    channels[CHANNEL_TACRADS_HIGH_TAIL][i] = tacradsHighTail;
+    channels[CHANNEL_ROTOR_POSITION_TAIL_MUTING][i] = rotorPositionTailMuting;
+    channels[CHANNEL_ROTOR_POSITION_TAIL_FPS_MUTING][i] = fpsAccTail;
+}
 
-    float bladeOffsetStep = 360.0f / acfNumBlades;
-    float propAngle = XPLMGetDataf(rotorPositionMainDataRef) - bladeOffsetStep * 0.5f;
+static void UpdateRotor(const InstanceInputs *__restrict inputs, InstanceOutputs *__restrict outputs, int count)
+{
+    for (int i = 0; i < count; i++)
+        StepRotor(inputs, outputs, i);
 
-    float pointPitchDeg = 0.0f;
-    XPLMGetDatavf(pointPitchDegDataRef, &pointPitchDeg, 0, 1);
+    UpdateBladePitch(inputs, count);
+    UpdateBladeDynamics(inputs, count);
+}
 
-    float bladePitch[5];
-    for (int i = 0; i < 5; i++)
+// computes only the disc tilt override of all instances, exactly like
+// StepRotor does, for the sim thread while the worker owns the rotor state
+static void UpdateDiscTilt(const InstanceInputs *__restrict inputs, InstanceOutputs *__restrict outputs, int count)
+{
+    for (int i = 0; i < count; i++)
     {
-        float bladeOffset = DegreesToRadians(propAngle + i * bladeOffsetStep);
-
-        bladePitch[i] = (((XPLMGetDataf(acfCyclicAilnDataRef) * XPLMGetDataf(yolkRollRatioDataRef) * cos(bladeOffset)) - (XPLMGetDataf(acfCyclicElevDataRef) * XPLMGetDataf( yolkPitchRatioDataRef) * sin(bladeOffset))) * -1.0f) + pointPitchDeg;
+        int high = inputs->pointTacrad[0][i] >= inputs->tuning.mutingTacrad;
+        outputs->cyclicElevDiscTilt[i] = high ? 0.0f : inputs->cyclicElevDiscTilt[i];
+        outputs->cyclicAilnDiscTilt[i] = high ? 0.0f : inputs->cyclicAilnDiscTilt[i];
     }
-
-    rotorBladesPitch0 = bladePitch[0];
-    rotorBladesPitch1 = bladePitch[1];
-    rotorBladesPitch2 = bladePitch[2];
-    rotorBladesPitch3 = bladePitch[3];
-    rotorBladesPitch4 = bladePitch[4];
 }
 
 inline static float CourseToLocation(float deltaX, float deltaY)
 {
-    return atan2(deltaY, deltaX) * 180.0f / M_PI;
+    return MathAtan2(deltaY, deltaX) * (float) (180.0 / M_PI);
 }
 
-static void UpdatePilot(void)
+// turns the pilot's head of an instance for deltaTime seconds
+inline static void StepPilot(const InstanceInputs *__restrict inputs, float deltaTime, int i)
 {
-    float headHeading = XPLMGetDataf(headHeadingDataRef);
-    float targetHeading = 0.0f;
+    float *headHeading = instances.channels[CHANNEL_HEAD_HEADING];
+    float headLimit = inputs->tuning.headLimit;
+    float phi = inputs->phi[i];
 
-    if (XPLMGetDatai(ongroundAnyDataRef) == 1)
     // aircraft on ground
-    {
-        float targetHeading = CourseToLocation(XPLMGetDataf(viewXDataRef) - XPLMGetDataf(localXDataRef), XPLMGetDataf(viewZDataRef) - XPLMGetDataf(localZDataRef)) - XPLMGetDataf(psiDataRef);
+    float groundHeading = WrapDegrees(CourseToLocation(inputs->viewX[i] - inputs->localX[i], inputs->viewZ[i] - inputs->localZ[i]) - inputs->psi[i]);
+    groundHeading = groundHeading > 92.0f || groundHeading < -100.0f ? 0.0f : groundHeading;
 
-        if (targetHeading > 180.0f)
-            targetHeading -= 360.0f;
-        else if (targetHeading < -180.0f)
-            targetHeading += 360.0f;
-
-        if (targetHeading > 92.0f || targetHeading < -100.0f)
-            targetHeading = 0.0f;
-    }
     // aircraft not on ground
-    else
-        targetHeading = XPLMGetDataf(phiDataRef);
+    float targetHeading = inputs->ongroundAny[i] == 1 ? groundHeading : phi;
+    targetHeading = targetHeading < -headLimit ? -headLimit : targetHeading > headLimit ? headLimit : targetHeading;
 
-    if (targetHeading < -70.0f)
-        targetHeading = -70.0f;
-    else if (targetHeading > 70.0f)
-        targetHeading = 70.0f;
+    float heading = headHeading[i];
+    float headingTargetDistancePercent = (targetHeading - heading) / 25.0f;
+    headingTargetDistancePercent = headingTargetDistancePercent > 1.0f ? 1.0f : headingTargetDistancePercent < -1.0f ? -1.0f : headingTargetDistancePercent;
 
-    float headingTargetDistancePercent = (targetHeading - headHeading) / 25.0f;
+    heading += inputs->tuning.headRotationSpeed * headingTargetDistancePercent * deltaTime;
+    heading = heading < -headLimit ? -headLimit : heading > headLimit ? headLimit : heading;
 
-    if (headingTargetDistancePercent > 1.0f)
-        headingTargetDistancePercent = 1.0f;
-    else if (headingTargetDistancePercent < -1.0f)
-        headingTargetDistancePercent = -1.0f;
+    headHeading[i] = heading;
+}
 
-    float headRotationSpeed = 150.0f;
+// turns the pilot's head of all instances for deltaTime seconds
+static void UpdatePilot(const InstanceInputs *__restrict inputs, float deltaTime, int count)
+{
+    for (int i = 0; i < count; i++)
+        StepPilot(inputs, deltaTime, i);
+}
 
-    headHeading += HEAD_ROTATION_SPEED * headingTargetDistancePercent * XPLMGetDataf(frameRatePeriodDataRef);
+// audio panel selector position that selects each flag channel, other
+// positions leave the flags unchanged
+static const int audioPanelPositions[CHANNEL_NAV2 - CHANNEL_ADF1 + 1] = {2, 3, 10, 11, 5, 0, 1};
 
-    if (headHeading < -70.0f)
-          headHeading = -70.0f;
-    else if (headHeading > 70.0f)
-          headHeading = 70.0f;
+// mirrors the audio panel selector of an instance into the flag channels
+inline static void StepSwitches(const InstanceInputs *__restrict inputs, int i)
+{
+    int audioPanelOut = inputs->audioPanelOut[i];
+    int known = 0;
+
+    float flags[CHANNEL_NAV2 - CHANNEL_ADF1 + 1];
+    for (int channel = CHANNEL_ADF1; channel <= CHANNEL_NAV2; channel++)
+    {
+        flags[channel - CHANNEL_ADF1] = instances.channels[channel][i];
+        known |= audioPanelOut == audioPanelPositions[channel - CHANNEL_ADF1];
+    }
 
-    headHeading = headHeading;
+    if (known)
+    {
+        for (int channel = CHANNEL_ADF1; channel <= CHANNEL_NAV2; channel++)
+            flags[channel - CHANNEL_ADF1] = audioPanelOut == audioPanelPositions[channel - CHANNEL_ADF1] ? 1.0f : 0.0f;
+    }
+
+    for (int channel = CHANNEL_ADF1; channel <= CHANNEL_NAV2; channel++)
+        instances.channels[channel][i] = flags[channel - CHANNEL_ADF1];
 }
 
-static void UpdateSwitches(void)
+static void UpdateSwitches(const InstanceInputs *__restrict inputs, int count)
 {
-    switch (XPLMGetDatai(audioPanelOutDataRef))
-    {
-        case 0:
-            adf1 = 0.0f;
-            adf2 = 0.0f;
-            com1 = 0.0f;
-            com2 = 0.0f;
-            dme = 0.0f;
-            nav1 = 1.0f;
-            nav2 = 0.0f;
-            break;
+    for (int i = 0; i < count; i++)
+        StepSwitches(inputs, i);
+}
 
-        case 1:
-            adf1 = 0.0f;
-            adf2 = 0.0f;
-            com1 = 0.0f;
-            com2 = 0.0f;
-            dme = 0.0f;
-            nav1 = 0.0f;
-            nav2 = 1.0f;
-            break;
+inline static void StepTransitionalShudder(const InstanceInputs *__restrict inputs, InstanceOutputs *__restrict outputs, int i)
+{
+    float p = inputs->pDot[i];
+    float q = inputs->qDot[i];
 
-        case 2:
-            adf1 = 1.0f;
-            adf2 = 0.0f;
-            com1 = 0.0f;
-            com2 = 0.0f;
-            dme = 0.0f;
-            nav1 = 0.0f;
-            nav2 = 0.0f;
-            break;
+    const Tuning *tuning = &inputs->tuning;
 
-        case 3:
-            adf1 = 0.0f;
-            adf2 = 1.0f;
-            com1 = 0.0f;
-            com2 = 0.0f;
-            dme = 0.0f;
-            nav1 = 0.0f;
-            nav2 = 0.0f;
-            break;
+    int onground = inputs->ongroundAny[i] != 0;
+    p = onground ? p * tuning->shudderGroundRoll : p;
+    q = onground ? q * tuning->shudderGroundPitch : q;
 
-        case 5:
-            adf1 = 0.0f;
-            adf2 = 0.0f;
-            com1 = 0.0f;
-            com2 = 0.0f;
-            dme = 1.0f;
-            nav1 = 0.0f;
-            nav2 = 0.0f;
-            break;
+    p += MathSin(inputs->pointTacrad[4][i] * tuning->shudderFrequency) * inputs->pointTacrad[0][i] * tuning->shudderRoll;
+    q += MathSin(inputs->pointTacrad[5][i] * tuning->shudderFrequency) * inputs->pointTacrad[1][i] * tuning->shudderPitch;
 
-        case 10:
-            adf1 = 0.0f;
-            adf2 = 0.0f;
-            com1 = 1.0f;
-            com2 = 0.0f;
-            dme = 0.0f;
-            nav1 = 0.0f;
-            nav2 = 0.0f;
-            break;
+    outputs->pDot[i] = p;
+    outputs->qDot[i] = q;
+}
 
-        case 11:
-            adf1 = 0.0f;
-            adf2 = 0.0f;
-            com1 = 0.0f;
-            com2 = 1.0f;
-            dme = 0.0f;
-            nav1 = 0.0f;
-            nav2 = 0.0f;
-            break;
+static void UpdateTransitionalShudder(const InstanceInputs *__restrict inputs, InstanceOutputs *__restrict outputs, int count)
+{
+    for (int i = 0; i < count; i++)
+        StepTransitionalShudder(inputs, outputs, i);
+}
+
+// computes the doors, rotor, pilot and switches outputs of all instances in a
+// single pass, bit-for-bit equivalent to calling the individual Update*
+// functions
+static void UpdateFused(const InstanceInputs *__restrict inputs, InstanceOutputs *__restrict outputs, int count)
+{
+    const float frameRatePeriod = inputs->frameRatePeriod;
+
+    for (int i = 0; i < count; i++)
+    {
+        StepDoors(inputs, frameRatePeriod, i);
+        StepRotor(inputs, outputs, i);
+        StepPilot(inputs, frameRatePeriod, i);
+        StepSwitches(inputs, i);
     }
+
+    UpdateBladePitch(inputs, count);
+    UpdateBladeDynamics(inputs, count);
+}
+
+// runs the individual Update* functions one after another, kept as the
+// reference the fused kernel is compared against
+static void UpdateReference(const InstanceInputs *__restrict inputs, InstanceOutputs *__restrict outputs, int count)
+{
+    UpdateDoors(inputs, inputs->frameRatePeriod, count);
+    UpdateRotor(inputs, outputs, count);
+    UpdatePilot(inputs, inputs->frameRatePeriod, count);
+    UpdateSwitches(inputs, count);
 }
 
-static void UpdateTransitionalShudder(void)
+// runs the after flight model subsystems whose bits are set in stages with
+// their time steps, in the order the flight loops run them, referenceUpdate
+// selects the kernel of single loop builds
+// returns whether the doors are still moving if they ran, -1 otherwise
+static int RunStages(const InstanceInputs *__restrict inputs, InstanceOutputs *__restrict outputs, uint32_t stages, const float *deltaTimes, int referenceUpdate, int count)
 {
-    float p = XPLMGetDataf(pDotDataRef);
-    float q = XPLMGetDataf(qDotDataRef);
+    int moving = -1;
 
-    if (XPLMGetDatai(ongroundAnyDataRef))
+    if (stages & (1u << PROFILE_ROTOR))
+        UpdateRotor(inputs, outputs, count);
+    if (stages & (1u << PROFILE_PILOT))
+        UpdatePilot(inputs, deltaTimes[PROFILE_PILOT], count);
+    if (stages & (1u << PROFILE_SWITCHES))
+        UpdateSwitches(inputs, count);
+    if (stages & (1u << PROFILE_DOORS))
+        moving = UpdateDoors(inputs, deltaTimes[PROFILE_DOORS], count);
+    if (stages & (1u << PROFILE_FRAME))
     {
-        p *= 0.001f;
-        q *= 0.5f;
+        if (referenceUpdate)
+            UpdateReference(inputs, outputs, count);
+        else
+            UpdateFused(inputs, outputs, count);
     }
 
-    float pointTacrad[8];
-    XPLMGetDatavf(pointTacradDataRef, pointTacrad, 0, 8);
+    return moving;
+}
 
-    p += sin(pointTacrad[4] * 0.03f) * pointTacrad[0] * 0.05f;
-    q += sin(pointTacrad[5] * 0.03f) * pointTacrad[1] * 0.005f;
+// returns whether the door request of any instance differs from the one its
+// doors last ran with
+static int DoorsRequestChanged(const InstanceInputs *inputs, int count)
+{
+    int changed = 0;
 
-    XPLMSetDataf(pDotDataRef, p);
-    XPLMSetDataf(qDotDataRef, q);
+    for (int i = 0; i < count; i++)
+        changed |= inputs->flaprqst[i] != doorsRequest[i];
+
+    return changed;
 }
 
-// flightloop-callback that handles everything
-static float FlightLoopCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop, int inCounter, void *inRefcon)
+// returns the level of detail of a group at distance, coming from tier; a
+// level is only left once the distance is LOD_HYSTERESIS past its threshold,
+// so a camera resting on a threshold does not flip between two levels
+static int32_t SelectLodTier(const LodDescriptor *lod, int32_t tier, float distance)
 {
-    UpdateDoors();
-    UpdateRotor();
-    UpdatePilot();
-    UpdateSwitches();
-    UpdateTransitionalShudder();
+    float out = 1.0f + LOD_HYSTERESIS, in = 1.0f - LOD_HYSTERESIS;
+    int32_t coarsest = distance < lod->reducedDistance * in ? LOD_FULL : distance < lod->frozenDistance * in ? LOD_REDUCED : LOD_FROZEN;
+    int32_t finest = distance > lod->frozenDistance * out ? LOD_FROZEN : distance > lod->reducedDistance * out ? LOD_REDUCED : LOD_FULL;
 
-    return -1.0f;
+    return tier < finest ? finest : tier > coarsest ? coarsest : tier;
+}
+
+// moves the level of detail of every group to the current camera distance
+static void UpdateLod(SimInputs *inputs)
+{
+    for (int i = 0; i < LOD_GROUP_COUNT; i++)
+        inputs->lodTiers[i] = SelectLodTier(&lodDescriptors[i], inputs->lodTiers[i], inputs->cameraDistance);
+}
+
+// smooths the frame period of the frame and moves the governor level by one
+// once the frame period has stayed on one side of the target long enough,
+// time in between resets the wait; the timer counts up while shedding and down
+// while restoring
+static void UpdateGovernor(SimInputs *inputs)
+{
+    const float targetPeriod = 1.0f / GOVERNOR_TARGET_FPS;
+    float period = inputs->frameRatePeriod;
+    if (period <= 0.0f)
+        return;
+
+    governorPeriod += (period - governorPeriod) * period / (GOVERNOR_SMOOTHING_TIME + period);
+
+    int32_t level = inputs->governorLevel;
+    if (governorPeriod > targetPeriod && level < GOVERNOR_LEVEL_COUNT - 1)
+    {
+        governorTimer = governorTimer > 0.0f ? governorTimer + period : period;
+        if (governorTimer >= GOVERNOR_SHED_TIME)
+        {
+            inputs->governorLevel = level + 1;
+            governorTimer = 0.0f;
+        }
+    }
+    else if (governorPeriod < targetPeriod * GOVERNOR_RESTORE_RATIO && level > 0)
+    {
+        governorTimer = governorTimer < 0.0f ? governorTimer - period : -period;
+        if (governorTimer <= -GOVERNOR_RESTORE_TIME)
+        {
+            inputs->governorLevel = level - 1;
+            governorTimer = 0.0f;
+        }
+    }
+    else
+        governorTimer = 0.0f;
+}
+
+#if TELEMETRY
+// fills in what the sim thread knows about the current frame once all of its
+// flight loops have run
+static void BeginTelemetryRecord(TelemetryRecord *record, int cycle)
+{
+    record->sequence = ++telemetrySequence;
+    record->cycle = cycle;
+    record->elapsedTime = XPLMGetElapsedTime();
+    record->inputs = simInputs;
+    GetInstanceOutputs(&instanceOutputs, 0, &record->outputs);
+}
+
+// fills in the state of the user's aircraft at the end of the frame
+static void CompleteTelemetryRecord(TelemetryRecord *record)
+{
+    record->doorTime = instances.doorTime[0];
+    record->doorOpen = instances.doorOpen[0];
+    for (int i = 0; i < CHANNEL_COUNT; i++)
+        record->channels[i] = GetChannel(i, 0);
+    record->bladeDynamics = instances.bladeDynamics[0];
+}
+#endif
+
+#if WORKER
+// one frame for the worker: its inputs, the record of the stages that ran in
+// it with their time steps, which the worker completes and pushes while
+// telemetry is recording, and the channels written through the datarefs since
+// the previous frame
+struct WorkerJob
+{
+    InstanceInputs inputs;
+    TelemetryRecord record;
+    int recordTelemetry;
+    int result;
+    float channelWrites[CHANNEL_COUNT];
+    unsigned char channelWritten[CHANNEL_COUNT];
+};
+
+// results of one frame: the channels of the user's aircraft and whether the
+// doors are still moving, -1 if they did not run
+struct WorkerResult
+{
+    float channels[CHANNEL_COUNT];
+    int doorsMoving;
+};
+
+// the results are double-buffered, the worker writes one buffer while the
+// datarefs read the other, and the buffers only swap between flight loops
+static Worker worker;
+static WorkerJob workerJob;
+static WorkerResult workerResults[2];
+static InstanceOutputs workerOutputs;
+static int workerFront = 0, workerBusy = 0;
+static float channelWrites[CHANNEL_COUNT];
+static unsigned char channelWritten[CHANNEL_COUNT];
+
+// runs a frame on the worker thread, which owns the instance state while it is
+// running
+static void RunWorkerJob(void *job)
+{
+    WorkerJob *frame = (WorkerJob *) job;
+
+    for (int i = 0; i < CHANNEL_COUNT; i++)
+    {
+        if (frame->channelWritten[i])
+            SetChannel(i, 0, frame->channelWrites[i]);
+    }
+
+    WorkerResult *result = &workerResults[frame->result];
+    result->doorsMoving = RunStages(&frame->inputs, &workerOutputs, frame->record.stages, frame->record.deltaTimes, REFERENCE_UPDATE, instanceCount);
+    for (int i = 0; i < CHANNEL_COUNT; i++)
+        result->channels[i] = GetChannel(i, 0);
+
+#if TELEMETRY
+    if (frame->recordTelemetry)
+    {
+        CompleteTelemetryRecord(&frame->record);
+        TelemetryPush(&telemetryWriter.ring, &frame->record);
+    }
+#endif
+}
+
+// waits for the frame handed to the worker and publishes its results
+static void CollectWorker(void)
+{
+    if (!workerBusy)
+        return;
+
+    WorkerWait(&worker);
+    workerBusy = 0;
+    workerFront = workerJob.result;
+
+    // writes that have not reached the worker yet stay visible
+    WorkerResult *result = &workerResults[workerFront];
+    for (int i = 0; i < CHANNEL_COUNT; i++)
+    {
+        if (channelWritten[i])
+            result->channels[i] = channelWrites[i];
+    }
+
+    // the doors flight loop decides on older results whether to rest, so it
+    // is woken up again if the doors turn out to be moving
+    if (result->doorsMoving == 1 && !doorsMoving && doorsFlightLoop != NULL)
+        XPLMScheduleFlightLoop(doorsFlightLoop, -1.0f, 1);
+    if (result->doorsMoving >= 0)
+        doorsMoving = result->doorsMoving;
 }
 
-// get doorsLeftPosition
-static float GetDoorsLeftPositionCallback(void *inRefcon)
+// hands the current frame to the worker, made up of the stages noted in the
+// telemetry record
+static void SubmitWorker(int cycle)
 {
-    return doorsLeftPosition;
+    WorkerJob *job = &workerJob;
+    job->inputs = instanceInputs;
+    job->record = telemetryRecord;
+    job->recordTelemetry = 0;
+#if TELEMETRY
+    if (telemetryFlightLoop != NULL)
+    {
+        BeginTelemetryRecord(&job->record, cycle);
+        job->recordTelemetry = 1;
+    }
+#endif
+    memcpy(job->channelWrites, channelWrites, sizeof(channelWrites));
+    memcpy(job->channelWritten, channelWritten, sizeof(channelWritten));
+    memset(channelWritten, 0, sizeof(channelWritten));
+    job->result = workerFront ^ 1;
+
+    WorkerSubmit(&worker);
+    workerBusy = 1;
 }
 
-// set doorsLeftPosition
-static void SetDoorsLeftPositionCallback(void *inRefcon, float newDoorsLeftPosition)
+// moves the animation onto the worker thread, which takes over the state of
+// the instances as it is
+static void StartWorker(void)
 {
-    doorsLeftPosition = newDoorsLeftPosition;
+    for (int i = 0; i < CHANNEL_COUNT; i++)
+        workerResults[0].channels[i] = GetChannel(i, 0);
+    workerResults[0].doorsMoving = -1;
+    workerFront = 0;
+    memset(channelWritten, 0, sizeof(channelWritten));
+
+    if (!WorkerStart(&worker, RunWorkerJob, &workerJob))
+    {
+        XPLMDebugString(NAME ": cannot start the worker thread, animating on the sim thread\n");
+        workerRequested = 0;
+        return;
+    }
+
+    workerRunning = 1;
 }
 
-// get doorsRightPosition
-static float GetDoorsRightPositionCallback(void *inRefcon)
+// moves the animation back onto the sim thread once the worker has finished
+// its last frame
+static void StopWorker(void)
 {
-    return doorsRightPosition;
+    if (!workerRunning)
+        return;
+
+    CollectWorker();
+    WorkerStop(&worker);
+    workerRunning = 0;
+
+    // the sim thread takes the state back along with the writes the worker has
+    // not seen
+    for (int i = 0; i < CHANNEL_COUNT; i++)
+    {
+        if (channelWritten[i])
+            SetChannel(i, 0, channelWrites[i]);
+    }
 }
 
-// set doorsRightPosition
-static void SetDoorsRightPositionCallback(void *inRefcon, float newDoorsRightPosition)
+// flightloop-callback that hands the frame to the worker, created after all
+// other after flight model loops so that it sees every stage of the frame
+static float WorkerFlightLoopCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop, int inCounter, void *inRefcon)
+{
+    if (!workerRunning)
+        return -1.0f;
+
+    uint64_t startTicks = ProfileBegin();
+    CollectWorker();
+    SubmitWorker(inCounter);
+    ProfileEnd(PROFILE_FRAME, startTicks);
+
+    // the next frame starts without any stage
+    telemetryRecord.stages = 0;
+    memset(telemetryRecord.deltaTimes, 0, sizeof(telemetryRecord.deltaTimes));
+
+    return -1.0f;
+}
+#else
+static void CollectWorker(void)
 {
-    doorsRightPosition = newDoorsRightPosition;
 }
 
-// get adf1
-static float GetAdf1Callback(void *inRefcon)
+static void StartWorker(void)
 {
-    return adf1;
+    workerRequested = 0;
 }
 
-// set adf1
-static void SetAdf1Callback(void *inRefcon, float newAdf1)
+static void StopWorker(void)
 {
-    adf1 = newAdf1;
 }
+#endif
 
-// get adf2
-static float GetAdf2Callback(void *inRefcon)
+// flightloop-callback that runs before the flight model and feeds the
+// transitional shudder into the angular accelerations it integrates
+static float ShudderFlightLoopCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop, int inCounter, void *inRefcon)
 {
-    return adf2;
+    // this is the first flight loop of a frame, switching here runs every
+    // frame entirely on one thread
+    if (workerRequested && !workerRunning)
+        StartWorker();
+    else if (!workerRequested && workerRunning)
+        StopWorker();
+
+    // every subsystem of the frame runs with the tuning it starts with
+    simInputs.tuning = activeTuning;
+    if (skippedSubsystems & (1u << PROFILE_SHUDDER))
+        return -1.0f;
+
+    ReadShudderInputs(&simInputs);
+    SetInstanceInputs(&instanceInputs, 0, &simInputs);
+
+    uint64_t startTicks = ProfileBegin();
+    UpdateTransitionalShudder(&instanceInputs, &instanceOutputs, instanceCount);
+    ProfileEnd(PROFILE_SHUDDER, startTicks);
+
+    RecordStage(PROFILE_SHUDDER, simInputs.frameRatePeriod);
+    if (telemetryFlightLoop != NULL)
+        telemetryRecord.shudderInputs = simInputs;
+
+    WriteShudderOutputs(&instanceOutputs);
+
+    return -1.0f;
+}
+
+#if SCHEDULED_UPDATE
+// flightloop-callback for the subsystems that animate every frame after the
+// flight model, also wakes the doors up when the door request changes
+static float FrameFlightLoopCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop, int inCounter, void *inRefcon)
+{
+    // the level of detail is chosen before any subsystem of the frame runs, a
+    // group that can be seen again is brought up to date in the same frame
+    int32_t pilotTier = simInputs.lodTiers[LOD_PILOT], switchesTier = simInputs.lodTiers[LOD_SWITCHES];
+    ReadLodInputs(&simInputs);
+    UpdateLod(&simInputs);
+    if (simInputs.lodTiers[LOD_PILOT] < pilotTier)
+        XPLMScheduleFlightLoop(pilotFlightLoop, -1.0f, 1);
+    if (simInputs.lodTiers[LOD_SWITCHES] < switchesTier)
+        XPLMScheduleFlightLoop(switchesFlightLoop, -1.0f, 1);
+
+    int rotor = !(skippedSubsystems & (1u << PROFILE_ROTOR));
+    int doors = !(skippedSubsystems & (1u << PROFILE_DOORS));
+    if (rotor)
+    {
+        ReadFrameInputs(&simInputs);
+        UpdateGovernor(&simInputs);
+    }
+    if (doors)
+        ReadDoorsRequest(&simInputs);
+    SetInstanceInputs(&instanceInputs, 0, &simInputs);
+
+    // the worker owns the rotor state, but the disc tilt override has to
+    // survive the flight model of this frame
+    if (rotor)
+    {
+        uint64_t startTicks = ProfileBegin();
+        if (workerRunning)
+            UpdateDiscTilt(&instanceInputs, &instanceOutputs, instanceCount);
+        else
+            UpdateRotor(&instanceInputs, &instanceOutputs, instanceCount);
+        ProfileEnd(PROFILE_ROTOR, startTicks);
+        RecordStage(PROFILE_ROTOR, simInputs.frameRatePeriod);
+
+        WriteRotorOutputs(&instanceOutputs);
+    }
+
+    if (doors && !doorsMoving && DoorsRequestChanged(&instanceInputs, instanceCount))
+    {
+        doorsMoving = 1;
+        XPLMScheduleFlightLoop(doorsFlightLoop, -1.0f, 1);
+    }
+
+    return ROTOR_INTERVAL;
 }
 
-// set adf2
-static void SetAdf2Callback(void *inRefcon, float newAdf2)
+// flightloop-callback for the pilot
+static float PilotFlightLoopCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop, int inCounter, void *inRefcon)
 {
-    adf2 = newAdf2;
+    // a frozen pilot is only looked in on at the reduced interval, the head
+    // turns on from where it stopped once it can be seen again
+    int32_t tier = simInputs.lodTiers[LOD_PILOT];
+    float interval = tier == LOD_FULL ? PILOT_INTERVAL * governorLevels[simInputs.governorLevel].pilotScale : LOD_PILOT_INTERVAL;
+    if ((skippedSubsystems & (1u << PROFILE_PILOT)) || tier == LOD_FROZEN)
+        return interval;
+
+    ReadPilotInputs(&simInputs);
+    SetInstanceInputs(&instanceInputs, 0, &simInputs);
+
+    if (!workerRunning)
+    {
+        uint64_t startTicks = ProfileBegin();
+        UpdatePilot(&instanceInputs, inElapsedSinceLastCall, instanceCount);
+        ProfileEnd(PROFILE_PILOT, startTicks);
+    }
+    RecordStage(PROFILE_PILOT, inElapsedSinceLastCall);
+
+    return interval;
 }
 
-// get com1
-static float GetCom1Callback(void *inRefcon)
+// flightloop-callback for the switches
+static float SwitchesFlightLoopCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop, int inCounter, void *inRefcon)
 {
-    return com1;
+    float interval = SWITCHES_INTERVAL * governorLevels[simInputs.governorLevel].switchesScale;
+    if ((skippedSubsystems & (1u << PROFILE_SWITCHES)) || simInputs.lodTiers[LOD_SWITCHES] == LOD_FROZEN)
+        return interval;
+
+    ReadSwitchesInputs(&simInputs);
+    SetInstanceInputs(&instanceInputs, 0, &simInputs);
+
+    if (!workerRunning)
+    {
+        uint64_t startTicks = ProfileBegin();
+        UpdateSwitches(&instanceInputs, instanceCount);
+        ProfileEnd(PROFILE_SWITCHES, startTicks);
+    }
+    RecordStage(PROFILE_SWITCHES, inElapsedSinceLastCall);
+
+    return interval;
 }
 
-// set com1
-static void SetCom1Callback(void *inRefcon, float newCom1)
+// flightloop-callback for the doors, unschedules itself once they are at rest
+static float DoorsFlightLoopCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop, int inCounter, void *inRefcon)
 {
-    com1 = newCom1;
+    // the doors are woken up again once their inputs are back
+    if (skippedSubsystems & (1u << PROFILE_DOORS))
+    {
+        doorsMoving = 0;
+        return 0.0f;
+    }
+
+    // the time since the last call includes the time spent at rest, so the
+    // first step after waking up uses the frame period instead
+    ReadDoorsInputs(&simInputs);
+    SetInstanceInputs(&instanceInputs, 0, &simInputs);
+
+    float deltaTime = DoorsRequestChanged(&instanceInputs, instanceCount) ? simInputs.frameRatePeriod : inElapsedSinceLastCall;
+    memcpy(doorsRequest, instanceInputs.flaprqst, sizeof(doorsRequest));
+
+    // the worker reports back whether the doors are still moving
+    if (!workerRunning)
+    {
+        uint64_t startTicks = ProfileBegin();
+        doorsMoving = UpdateDoors(&instanceInputs, deltaTime, instanceCount);
+        ProfileEnd(PROFILE_DOORS, startTicks);
+    }
+    RecordStage(PROFILE_DOORS, deltaTime);
+
+    return doorsMoving ? DOORS_INTERVAL : 0.0f;
 }
+#else
+// flightloop-callback that handles everything after the flight model
+static float FrameFlightLoopCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop, int inCounter, void *inRefcon)
+{
+    if (skippedSubsystems & (1u << PROFILE_FRAME))
+        return -1.0f;
+
+    // only the blade pitch has a level of detail in a single loop, the pilot
+    // and the switches are stepped along with everything else
+    ReadLodInputs(&simInputs);
+    UpdateLod(&simInputs);
+    ReadSimInputs(&simInputs);
+    UpdateGovernor(&simInputs);
+    SetInstanceInputs(&instanceInputs, 0, &simInputs);
+
+    uint64_t startTicks = ProfileBegin();
+    if (workerRunning)
+        UpdateDiscTilt(&instanceInputs, &instanceOutputs, instanceCount);
+#if REFERENCE_UPDATE
+    else
+        UpdateReference(&instanceInputs, &instanceOutputs, instanceCount);
+#else
+    else
+        UpdateFused(&instanceInputs, &instanceOutputs, instanceCount);
+#endif
+    ProfileEnd(PROFILE_FRAME, startTicks);
+    RecordStage(PROFILE_FRAME, simInputs.frameRatePeriod);
 
-// get com2
-static float GetCom2Callback(void *inRefcon)
+    WriteRotorOutputs(&instanceOutputs);
+
+    return -1.0f;
+}
+#endif
+
+#if TELEMETRY
+// flightloop-callback that records the state of every frame, created after all
+// other after flight model loops so that it sees their results
+static float TelemetryFlightLoopCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop, int inCounter, void *inRefcon)
 {
-    return com2;
+    // frames run by the worker are recorded by the worker
+    if (workerRunning)
+        return -1.0f;
+
+    TelemetryRecord *record = &telemetryRecord;
+    BeginTelemetryRecord(record, inCounter);
+    CompleteTelemetryRecord(record);
+
+    TelemetryPush(&telemetryWriter.ring, record);
+
+    // the next frame starts without any stage
+    record->stages = 0;
+    memset(record->deltaTimes, 0, sizeof(record->deltaTimes));
+
+    return -1.0f;
 }
+#endif
 
-// set com2
-static void SetCom2Callback(void *inRefcon, float newCom2)
+// creates a flight loop in the given phase and schedules it
+static XPLMFlightLoopID CreateFlightLoop(XPLMFlightLoopPhaseType phase, XPLMFlightLoop_f callback, float interval)
 {
-    com2 = newCom2;
+    XPLMCreateFlightLoop_t params = {sizeof(XPLMCreateFlightLoop_t), phase, callback, NULL};
+    XPLMFlightLoopID flightLoop = XPLMCreateFlightLoop(&params);
+    XPLMScheduleFlightLoop(flightLoop, interval, 1);
+
+    return flightLoop;
 }
 
-// get dme
-static float GetDmeCallback(void *inRefcon)
+// destroys a flight loop created by CreateFlightLoop, if any
+static void DestroyFlightLoop(XPLMFlightLoopID *flightLoop)
 {
-    return dme;
+    if (*flightLoop != NULL)
+    {
+        XPLMDestroyFlightLoop(*flightLoop);
+        *flightLoop = NULL;
+    }
 }
 
-// set dme
-static void SetDmeCallback(void *inRefcon, float newDme)
+#if TUNING
+// parses a tuning file of name and value lines, # starts a comment and fields
+// that are not listed keep their value; the text is read in place, so the
+// parser neither allocates nor needs it to be terminated
+// returns 0 and describes the first problem in error without touching tuning
+static int ParseTuning(const char *text, size_t size, Tuning *tuning, char *error, size_t errorSize)
 {
-    dme = newDme;
+    Tuning parsed = *tuning;
+    const char *end = text + size;
+    int line = 0;
+
+    for (const char *next = text; next < end;)
+    {
+        const char *lineEnd = (const char *) memchr(next, '\n', end - next);
+        if (lineEnd == NULL)
+            lineEnd = end;
+        line++;
+
+        const char *tokens[2];
+        size_t lengths[2];
+        int count = 0;
+        for (const char *c = next; c < lineEnd && *c != '#';)
+        {
+            if (*c == ' ' || *c == '\t' || *c == '\r')
+            {
+                c++;
+                continue;
+            }
+
+            const char *token = c;
+            while (c < lineEnd && *c != ' ' && *c != '\t' && *c != '\r' && *c != '#')
+                c++;
+
+            if (count == 2)
+                count = 3;
+            else
+            {
+                tokens[count] = token;
+                lengths[count++] = c - token;
+            }
+        }
+        next = lineEnd < end ? lineEnd + 1 : end;
+
+        if (count == 0)
+            continue;
+        if (count != 2)
+        {
+            snprintf(error, errorSize, "line %d: expected a name and a value", line);
+            return 0;
+        }
+
+        const TuningDescriptor *descriptor = NULL;
+        for (size_t i = 0; i < sizeof(tuningDescriptors) / sizeof(tuningDescriptors[0]); i++)
+        {
+            if (strlen(tuningDescriptors[i].name) == lengths[0] && strncmp(tuningDescriptors[i].name, tokens[0], lengths[0]) == 0)
+                descriptor = &tuningDescriptors[i];
+        }
+        if (descriptor == NULL)
+        {
+            snprintf(error, errorSize, "line %d: unknown name %.*s", line, (int) lengths[0], tokens[0]);
+            return 0;
+        }
+
+        char number[32], *rest;
+        if (lengths[1] >= sizeof(number))
+            lengths[1] = sizeof(number) - 1;
+        memcpy(number, tokens[1], lengths[1]);
+        number[lengths[1]] = '\0';
+        float value = strtof(number, &rest);
+        if (*rest != '\0' || !(value >= descriptor->min && value <= descriptor->max))
+        {
+            snprintf(error, errorSize, "line %d: %s has to be a number from %g to %g", line, descriptor->name, descriptor->min, descriptor->max);
+            return 0;
+        }
+
+        *(float *) ((char *) &parsed + descriptor->offset) = value;
+    }
+
+    *tuning = parsed;
+    return 1;
 }
 
-// get nav1
-static float GetNav1Callback(void *inRefcon)
+// maps the tuning file and swaps its values in if it parses, a file that does
+// not leaves the previous tuning in place; the tuning is latched into the
+// inputs at the start of every frame, so a frame never sees a mix of both
+static void LoadTuning(void)
 {
-    return nav1;
+    struct stat st;
+    int fd = open(tuningPath, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        // without a file the plugin runs with the built-in tuning
+        if (fd >= 0)
+            close(fd);
+        tuningModified = 0;
+        tuningSize = -1;
+        activeTuning = defaultTuning;
+        return;
+    }
+
+    tuningModified = st.st_mtime;
+    tuningSize = st.st_size;
+
+    Tuning tuning = defaultTuning;
+    char error[128];
+    int valid = 1;
+    if (st.st_size > 0)
+    {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            snprintf(error, sizeof(error), "the file cannot be mapped");
+            valid = 0;
+        }
+        else
+        {
+            valid = ParseTuning((const char *) data, st.st_size, &tuning, error, sizeof(error));
+            munmap(data, st.st_size);
+        }
+    }
+    close(fd);
+
+    char line[512 + 192];
+    if (valid)
+    {
+        activeTuning = tuning;
+        snprintf(line, sizeof(line), NAME ": loaded tuning from %s\n", tuningPath);
+    }
+    else
+        snprintf(line, sizeof(line), NAME ": ignoring tuning in %s, %s\n", tuningPath, error);
+    XPLMDebugString(line);
 }
 
-// set nav1
-static void SetNav1Callback(void *inRefcon, float newNav1)
+// flightloop-callback that reloads the tuning file whenever it has changed
+static float TuningFlightLoopCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop, int inCounter, void *inRefcon)
 {
-    nav1 = newNav1;
+    struct stat st;
+    int exists = stat(tuningPath, &st) == 0;
+    if (exists ? st.st_mtime != tuningModified || st.st_size != tuningSize : tuningSize >= 0)
+        LoadTuning();
+
+    return TUNING_CHECK_INTERVAL;
 }
+#endif
+
+// lines of the overlay text: a header, one row per subsystem, the plugin total
+// and the sparkline caption
+#define OVERLAY_LINES (PROFILE_COUNT + 3)
+#define OVERLAY_LINE_LENGTH 64
 
-// get nav2
-static float GetNav2Callback(void *inRefcon)
+// window that shows the profiler results while the sim is running
+// all text is formatted when a sample is taken and the window size is
+// measured once, so drawing only submits the cached strings and the sparkline;
+// hidden windows are not drawn and take no samples at all
+class PerfOverlay : public XPCWindow
 {
-    return nav2;
+public:
+    PerfOverlay(int inLeft, int inTop, int inRight, int inBottom);
+
+    void Reset(void);
+
+    virtual void DoDraw(void);
+    virtual void HandleKey(char inKey, XPLMKeyFlags inFlags, char inVirtualKey);
+    virtual void LoseFocus(void);
+    virtual int HandleClick(int x, int y, XPLMMouseStatus inMouse);
+
+private:
+    void Sample(double now);
+
+    char lines[OVERLAY_LINES][OVERLAY_LINE_LENGTH];
+    float history[OVERLAY_HISTORY];
+    float historyPeak;
+    int historyNext;
+    double lastSampleSeconds;
+    int lastCycle;
+    uint64_t lastCalls[PROFILE_COUNT];
+    uint64_t lastTicks[PROFILE_COUNT];
+};
+
+// items of the plugin menu
+enum
+{
+    MENU_ITEM_OVERLAY
+};
+
+// global overlay variables
+static XPLMMenuID pluginMenu = NULL;
+static int pluginMenuItem = -1, overlayMenuItem = -1, profilerEnabledBeforeOverlay = PROFILER;
+static PerfOverlay *perfOverlay = NULL;
+
+PerfOverlay::PerfOverlay(int inLeft, int inTop, int inRight, int inBottom) : XPCWindow(inLeft, inTop, inRight, inBottom, 0)
+{
+    Reset();
 }
 
-// set nav2
-static void SetNav2Callback(void *inRefcon, float newNav2)
+// starts the sparkline over and takes the next sample relative to now
+void PerfOverlay::Reset(void)
 {
-    nav2 = newNav2;
+    memset(lines, 0, sizeof(lines));
+    memset(history, 0, sizeof(history));
+    historyPeak = 0.0f;
+    historyNext = 0;
+    lastSampleSeconds = ProfilerSeconds();
+    lastCycle = XPLMGetCycleNumber();
+
+    for (int i = 0; i < PROFILE_COUNT; i++)
+    {
+        lastCalls[i] = profileHistograms[i].total;
+        lastTicks[i] = profileHistograms[i].totalTicks;
+    }
+
+    snprintf(lines[0], OVERLAY_LINE_LENGTH, "%-9s %8s %8s %8s", "", "p50 us", "p99 us", "calls/fr");
 }
 
-// get tacradsHighMain
-static float GetTacradsHighMainCallback(void *inRefcon)
+// formats the per-subsystem cost and the calls per frame since the last sample
+// and adds the plugin's share of the frame period to the sparkline
+void PerfOverlay::Sample(double now)
 {
-    return tacradsHighMain;
+    int cycle = XPLMGetCycleNumber();
+    int frames = cycle > lastCycle ? cycle - lastCycle : 1;
+    double pluginMicroseconds = 0.0;
+
+    for (int i = 0; i < PROFILE_COUNT; i++)
+    {
+        const ProfileHistogram *histogram = &profileHistograms[i];
+        double calls = (double) (histogram->total - lastCalls[i]) / frames;
+        pluginMicroseconds += ProfilerTicksToMicroseconds(&profileClock, (double) (histogram->totalTicks - lastTicks[i])) / frames;
+
+        snprintf(lines[i + 1], OVERLAY_LINE_LENGTH, "%-9s %8.2f %8.2f %8.2f", profileNames[i], ProfilerTicksToMicroseconds(&profileClock, ProfilerPercentile(histogram, 50.0)), ProfilerTicksToMicroseconds(&profileClock, ProfilerPercentile(histogram, 99.0)), calls);
+
+        lastCalls[i] = histogram->total;
+        lastTicks[i] = histogram->totalTicks;
+    }
+
+    float frameRatePeriod = simInputs.frameRatePeriod;
+    float share = frameRatePeriod > 0.0f ? (float) (pluginMicroseconds * 1e-4 / frameRatePeriod) : 0.0f;
+
+    history[historyNext] = share;
+    historyNext = (historyNext + 1) % OVERLAY_HISTORY;
+
+    historyPeak = 0.0f;
+    for (int i = 0; i < OVERLAY_HISTORY; i++)
+    {
+        if (history[i] > historyPeak)
+            historyPeak = history[i];
+    }
+
+    snprintf(lines[PROFILE_COUNT + 1], OVERLAY_LINE_LENGTH, "plugin %.2f us/frame, %.3f %% of %.1f ms", pluginMicroseconds, share, frameRatePeriod * 1000.0f);
+    snprintf(lines[PROFILE_COUNT + 2], OVERLAY_LINE_LENGTH, "last %.0f s, peak %.3f %%", OVERLAY_SAMPLE_INTERVAL * OVERLAY_HISTORY, historyPeak);
+
+    lastCycle = cycle;
+    lastSampleSeconds = now;
 }
 
-// set tacradsHighMain
-static void SetTacradsHighMainCallback(void *inRefcon, float newTacradsHighMain)
+void PerfOverlay::DoDraw(void)
 {
-    tacradsHighMain = newTacradsHighMain;
+    double now = ProfilerSeconds();
+    if (now - lastSampleSeconds >= OVERLAY_SAMPLE_INTERVAL)
+        Sample(now);
+
+    int left, top, right, bottom;
+    GetWindowGeometry(&left, &top, &right, &bottom);
+
+    XPLMDrawTranslucentDarkBox(left, top, right, bottom);
+
+    float white[] = {1.0f, 1.0f, 1.0f};
+    for (int i = 0; i < OVERLAY_LINES; i++)
+        XPLMDrawString(white, left + OVERLAY_PADDING, top - OVERLAY_PADDING - (i + 1) * OVERLAY_LINE_HEIGHT, lines[i], NULL, xplmFont_Basic);
+
+    // sparkline of the share of the frame period, oldest sample on the left
+    float scale = historyPeak > 0.0f ? OVERLAY_SPARKLINE_HEIGHT / historyPeak : 0.0f;
+    float step = (float) (right - left - 2 * OVERLAY_PADDING) / (OVERLAY_HISTORY - 1);
+    int base = bottom + OVERLAY_PADDING;
+
+    XPLMSetGraphicsState(0, 0, 0, 0, 1, 0, 0);
+    glColor3f(0.3f, 1.0f, 0.3f);
+    glBegin(GL_LINE_STRIP);
+    for (int i = 0; i < OVERLAY_HISTORY; i++)
+        glVertex2f(left + OVERLAY_PADDING + i * step, base + history[(historyNext + i) % OVERLAY_HISTORY] * scale);
+    glEnd();
 }
 
-// get tacradsHighTail
-static float GetTacradsHighTailCallback(void *inRefcon)
+void PerfOverlay::HandleKey(char inKey, XPLMKeyFlags inFlags, char inVirtualKey)
 {
-    return tacradsHighTail;
 }
 
-// set tacradsHighTail
-static void SetTacradsHighTailCallback(void *inRefcon, float newTacradsHighTail)
+void PerfOverlay::LoseFocus(void)
 {
-    tacradsHighTail = newTacradsHighTail;
 }
 
-// get headHeading
-static float GetHeadHeadingCallback(void *inRefcon)
+int PerfOverlay::HandleClick(int x, int y, XPLMMouseStatus inMouse)
 {
-    return headHeading;
+    return 0;
 }
 
-// set headHeading
-static void SetHeadHeadingCallback(void *inRefcon, float newHeadHeading)
+// creates the overlay in the top left corner of the screen, sized to fit the
+// widest line it can show
+static PerfOverlay *CreatePerfOverlay(void)
 {
-    headHeading = newHeadHeading;
+    char widestLine[OVERLAY_LINE_LENGTH];
+    snprintf(widestLine, sizeof(widestLine), "plugin %.2f us/frame, %.3f %% of %.1f ms", 9999.99, 99.999, 99.9);
+
+    int width = (int) XPLMMeasureString(xplmFont_Basic, widestLine, (int) strlen(widestLine)) + 2 * OVERLAY_PADDING;
+    int height = OVERLAY_LINES * OVERLAY_LINE_HEIGHT + OVERLAY_SPARKLINE_HEIGHT + 3 * OVERLAY_PADDING;
+
+    int screenWidth, screenHeight;
+    XPLMGetScreenSize(&screenWidth, &screenHeight);
+
+    int top = screenHeight - 4 * OVERLAY_LINE_HEIGHT;
+
+    return new PerfOverlay(OVERLAY_PADDING, top, OVERLAY_PADDING + width, top - height);
 }
 
-// get rotorBladesPitch0
-static float GetRotorBladesPitch0Callback(void *inRefcon)
+// shows or hides the overlay, the profiler is forced on while it is shown and
+// returns to its previous setting when it is hidden again
+static void SetPerfOverlayVisible(int visible)
 {
-    return rotorBladesPitch0;
+    if (visible)
+    {
+        if (perfOverlay == NULL)
+            perfOverlay = CreatePerfOverlay();
+
+        if (!perfOverlay->GetWindowIsVisible())
+        {
+            profilerEnabledBeforeOverlay = profilerEnabled;
+            profilerEnabled = 1;
+            perfOverlay->Reset();
+            perfOverlay->SetWindowIsVisible(1);
+        }
+    }
+    else if (perfOverlay != NULL && perfOverlay->GetWindowIsVisible())
+    {
+        perfOverlay->SetWindowIsVisible(0);
+        profilerEnabled = profilerEnabledBeforeOverlay;
+    }
+
+    XPLMCheckMenuItem(pluginMenu, overlayMenuItem, visible ? xplm_Menu_Checked : xplm_Menu_Unchecked);
 }
 
-// set rotorBladesPitch0
-static void SetRotorBladesPitch0Callback(void *inRefcon, float newRotorBladesPitch0)
+#if TELEMETRY
+// starts recording into a new file named after the current time in the
+// X-Plane folder
+static void StartTelemetry(void)
 {
-    rotorBladesPitch0 = newRotorBladesPitch0;
+    if (telemetryFlightLoop != NULL)
+        return;
+
+    char path[512 + 64], timestamp[32];
+    time_t now = time(NULL);
+    strftime(timestamp, sizeof(timestamp), "%Y%m%d-%H%M%S", localtime(&now));
+    XPLMGetSystemPath(path);
+    snprintf(path + strlen(path), 64, NAME_LOWERCASE "_telemetry_%s.bin", timestamp);
+
+    TelemetryFileHeader header;
+    memset(&header, 0, sizeof(header));
+    strcpy(header.magic, TELEMETRY_MAGIC);
+    header.version = TELEMETRY_VERSION;
+    header.headerSize = sizeof(TelemetryFileHeader);
+    header.recordSize = sizeof(TelemetryRecord);
+    header.channelCount = CHANNEL_COUNT;
+    header.referenceUpdate = REFERENCE_UPDATE;
+    header.trackChecksum = TrackChecksum(&trackTable);
+    for (int i = 0; i < CHANNEL_COUNT; i++)
+        strncpy(header.channelNames[i], channelDescriptors[i].name, TELEMETRY_NAME_LENGTH - 1);
+
+    if (!TelemetryOpen(&telemetryWriter, path, &header, sizeof(header), sizeof(TelemetryRecord), TELEMETRY_RING_RECORDS))
+    {
+        XPLMDebugString(NAME ": cannot record telemetry to ");
+        XPLMDebugString(path);
+        XPLMDebugString("\n");
+        return;
+    }
+
+    // the worker takes the stages of the current frame from the record
+    telemetrySequence = 0;
+    if (!workerRunning)
+        memset(&telemetryRecord, 0, sizeof(telemetryRecord));
+    telemetryFlightLoop = CreateFlightLoop(xplm_FlightLoop_Phase_AfterFlightModel, TelemetryFlightLoopCallback, -1.0f);
 }
 
-// get rotorBladesPitch1
-static float GetRotorBladesPitch1Callback(void *inRefcon)
+// stops recording and closes the file once every record has been written
+static void StopTelemetry(void)
+{
+    if (telemetryFlightLoop == NULL)
+        return;
+
+    // the worker may still be recording the previous frame
+    CollectWorker();
+    DestroyFlightLoop(&telemetryFlightLoop);
+
+    char line[128];
+    snprintf(line, sizeof(line), NAME ": recorded %u telemetry frames, %u dropped\n", telemetrySequence - telemetryWriter.ring.dropped.load(), telemetryWriter.ring.dropped.load());
+    XPLMDebugString(line);
+
+    if (!TelemetryClose(&telemetryWriter))
+        XPLMDebugString(NAME ": telemetry file incomplete, could not write to disk\n");
+}
+#else
+static void StartTelemetry(void)
 {
-    return rotorBladesPitch1;
 }
 
-// set rotorBladesPitch1
-static void SetRotorBladesPitch1Callback(void *inRefcon, float newRotorBladesPitch1)
+static void StopTelemetry(void)
 {
-    rotorBladesPitch1 = newRotorBladesPitch1;
 }
+#endif
 
-// get rotorBladesPitch2
-static float GetRotorBladesPitch2Callback(void *inRefcon)
+static int GetTelemetryEnabledCallback(void *inRefcon)
 {
-    return rotorBladesPitch2;
+    return telemetryRequested;
 }
 
-// set rotorBladesPitch2
-static void SetRotorBladesPitch2Callback(void *inRefcon, float newRotorBladesPitch2)
+static void SetTelemetryEnabledCallback(void *inRefcon, int inValue)
 {
-    rotorBladesPitch2 = newRotorBladesPitch2;
+    telemetryRequested = inValue != 0;
+
+    // recording starts with the flight loops once the plugin is enabled
+    if (telemetryRequested && frameFlightLoop != NULL)
+        StartTelemetry();
+    else
+        StopTelemetry();
 }
 
-// get rotorBladesPitch3
-static float GetRotorBladesPitch3Callback(void *inRefcon)
+static int GetTelemetryDroppedCallback(void *inRefcon)
 {
-    return rotorBladesPitch3;
+#if TELEMETRY
+    return telemetryFlightLoop != NULL ? (int) telemetryWriter.ring.dropped.load(std::memory_order_relaxed) : 0;
+#else
+    return 0;
+#endif
 }
 
-// set rotorBladesPitch3
-static void SetRotorBladesPitch3Callback(void *inRefcon, float newRotorBladesPitch3)
+static void MenuHandlerCallback(void *inMenuRef, void *inItemRef)
 {
-    rotorBladesPitch3 = newRotorBladesPitch3;
+    switch ((intptr_t) inItemRef)
+    {
+        case MENU_ITEM_OVERLAY:
+            SetPerfOverlayVisible(perfOverlay == NULL || !perfOverlay->GetWindowIsVisible());
+            break;
+    }
 }
 
-// get rotorBladesPitch4
-static float GetRotorBladesPitch4Callback(void *inRefcon)
+// reads a published channel of the user's aircraft
+static float GetPublishedChannel(int channel)
 {
-    return rotorBladesPitch4;
+#if WORKER
+    if (workerRunning)
+        return workerResults[workerFront].channels[channel];
+#endif
+
+    return GetChannel(channel, 0);
 }
 
-// set rotorBladesPitch4
-static void SetRotorBladesPitch4Callback(void *inRefcon, float newRotorBladesPitch4)
+// reads a published channel of the user's aircraft, the refcon holds the
+// channel index
+static float GetChannelCallback(void *inRefcon)
 {
-    rotorBladesPitch4 = newRotorBladesPitch4;
+    return GetPublishedChannel((intptr_t) inRefcon);
 }
 
-// get rotorMutingLowPitch
-static float GetRotorMutingLowPitchCallback(void *inRefcon)
+// writes a published channel of the user's aircraft, the refcon holds the
+// channel index
+static void SetChannelCallback(void *inRefcon, float inValue)
 {
-    return rotorMutingLowPitch;
+    intptr_t channel = (intptr_t) inRefcon;
+
+#if WORKER
+    // the worker applies the write at the start of the next frame it is handed
+    if (workerRunning)
+    {
+        channelWrites[channel] = inValue;
+        channelWritten[channel] = 1;
+        workerResults[workerFront].channels[channel] = inValue;
+        return;
+    }
+#endif
+
+    SetChannel(channel, 0, inValue);
 }
 
-// set rotorMutingLowPitch
-static void SetRotorMutingLowPitchCallback(void *inRefcon, float newRotorMutingLowPitch)
+// builds the name a channel is shared under
+static void GetSharedName(int channel, char *name, size_t size)
 {
-    rotorMutingLowPitch = newRotorMutingLowPitch;
+    snprintf(name, size, SHARE_PREFIX "%s", channelDescriptors[channel].name + strlen("abb/"));
 }
 
-// get rotorMutingLowRoll
-static float GetRotorMutingLowRollCallback(void *inRefcon)
+// called whenever shared data of a channel is set, by this plugin or another
+// one, the refcon holds the channel index; a value set by another plugin is
+// set back at the end of the frame
+static void SharedDataChangedCallback(void *inRefcon)
 {
-    return rotorMutingLowRoll;
+    intptr_t channel = (intptr_t) inRefcon;
+
+    if (XPLMGetDataf(sharedDataRefs[channel]) != sharedValues[channel])
+        sharedValues[channel] = NAN;
 }
 
-// set rotorMutingLowRoll
-static void SetRotorMutingLowRollCallback(void *inRefcon, float newRotorMutingLowRoll)
+// flightloop-callback that sets the shared data of the channels that have
+// changed, created after the worker loop so that it sees the results the
+// worker published in this frame
+static float ShareFlightLoopCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop, int inCounter, void *inRefcon)
 {
-    rotorMutingLowRoll = newRotorMutingLowRoll;
+    for (int i = 0; i < CHANNEL_COUNT; i++)
+    {
+        float value = GetPublishedChannel(i);
+        if (value != sharedValues[i])
+        {
+            sharedValues[i] = value;
+            XPLMSetDataf(sharedDataRefs[i], value);
+        }
+    }
+
+    return -1.0f;
 }
 
-// get rotorPositionMain
-static float GetRotorPositionMainCallback(void *inRefcon)
+// connects to the shared data of every channel, which is set to the current
+// values at the end of the next frame
+static void StartShare(void)
 {
-    return rotorPositionMain;
+    if (shareFlightLoop != NULL)
+        return;
+
+    for (intptr_t i = 0; i < CHANNEL_COUNT; i++)
+    {
+        char name[TELEMETRY_NAME_LENGTH + sizeof(SHARE_PREFIX)];
+        GetSharedName(i, name, sizeof(name));
+
+        // shared data of the same name but another type belongs to someone else
+        if (!XPLMShareData(name, xplmType_Float, SharedDataChangedCallback, (void *) i))
+        {
+            XPLMDebugString(NAME ": cannot share ");
+            XPLMDebugString(name);
+            XPLMDebugString(", it already exists with another type\n");
+
+            while (--i >= 0)
+            {
+                GetSharedName(i, name, sizeof(name));
+                XPLMUnshareData(name, xplmType_Float, SharedDataChangedCallback, (void *) i);
+            }
+            shareRequested = 0;
+            return;
+        }
+
+        sharedDataRefs[i] = XPLMFindDataRef(name);
+        sharedValues[i] = NAN;
+    }
+
+    shareFlightLoop = CreateFlightLoop(xplm_FlightLoop_Phase_AfterFlightModel, ShareFlightLoopCallback, -1.0f);
 }
 
-// set rotorPositionMain
-static void SetRotorPositionMainCallback(void *inRefcon, float newRotorPositionMain)
+// stops setting the shared data, which keeps its last values for other plugins
+static void StopShare(void)
 {
-    rotorPositionMain = newRotorPositionMain;
+    if (shareFlightLoop == NULL)
+        return;
+
+    DestroyFlightLoop(&shareFlightLoop);
+
+    for (intptr_t i = 0; i < CHANNEL_COUNT; i++)
+    {
+        char name[TELEMETRY_NAME_LENGTH + sizeof(SHARE_PREFIX)];
+        GetSharedName(i, name, sizeof(name));
+        XPLMUnshareData(name, xplmType_Float, SharedDataChangedCallback, (void *) i);
+        sharedDataRefs[i] = NULL;
+    }
 }
 
-// get rotorPositionMainMuting
-static float GetRotorPositionMainMutingCallback(void *inRefcon)
+static int GetWorkerEnabledCallback(void *inRefcon)
 {
-    return rotorPositionMainMuting;
+    return workerRequested;
 }
 
-// set rotorPositionMainMuting
-static void SetRotorPositionMainMutingCallback(void *inRefcon, float newRotorPositionMainMuting)
+// the worker is started or stopped at the start of the next frame
+static void SetWorkerEnabledCallback(void *inRefcon, int inValue)
 {
-    rotorPositionMainMuting = newRotorPositionMainMuting;
+    workerRequested = inValue != 0;
 }
 
-// get rotorPositionTail
-static float GetRotorPositionTailCallback(void *inRefcon)
+static int GetGovernorLevelCallback(void *inRefcon)
 {
-    return rotorPositionTail;
+    return simInputs.governorLevel;
 }
 
-// set rotorPositionTail
-static void SetRotorPositionTailCallback(void *inRefcon, float newRotorPositionTail)
+static int GetShareEnabledCallback(void *inRefcon)
 {
-    rotorPositionTail = newRotorPositionTail;
+    return shareRequested;
 }
 
-// get rotorPositionTailMuting
-static float GetRotorPositionTailMutingCallback(void *inRefcon)
+static void SetShareEnabledCallback(void *inRefcon, int inValue)
 {
-    return rotorPositionTailMuting;
+    shareRequested = inValue != 0;
+
+    // sharing starts with the flight loops once the plugin is enabled
+    if (shareRequested && frameFlightLoop != NULL)
+        StartShare();
+    else
+        StopShare();
 }
 
-// set rotorPositionTailMuting
-static void SetRotorPositionTailMutingCallback(void *inRefcon, float newRotorPositionTailMuting)
+static int GetProfilerEnabledCallback(void *inRefcon)
 {
-    rotorPositionTailMuting = newRotorPositionTailMuting;
+    return profilerEnabled;
 }
 
-// get rotorPositionMainFpsMuting
-static float GetRotorPositionMainFpsMutingCallback(void *inRefcon)
+static void SetProfilerEnabledCallback(void *inRefcon, int inValue)
 {
-    return rotorPositionMainFpsMuting;
+    profilerEnabled = inValue != 0;
 }
 
-// set rotorPositionMainFpsMuting
-static void SetRotorPositionMainFpsMutingCallback(void *inRefcon, float newRotorPositionMainFpsMuting)
+// reads a profiler result in microseconds, the refcon holds the subsystem
+// times the number of statistics plus the statistic
+static float GetProfileCallback(void *inRefcon)
 {
-    rotorPositionMainFpsMuting = newRotorPositionMainFpsMuting;
+    intptr_t index = (intptr_t) inRefcon;
+    const ProfileHistogram *histogram = &profileHistograms[index / PROFILE_STAT_COUNT];
+    double ticks = 0.0;
+
+    switch (index % PROFILE_STAT_COUNT)
+    {
+        case PROFILE_STAT_P50:
+            ticks = ProfilerPercentile(histogram, 50.0);
+            break;
+
+        case PROFILE_STAT_P99:
+            ticks = ProfilerPercentile(histogram, 99.0);
+            break;
+
+        case PROFILE_STAT_MAX:
+            ticks = ProfilerMax(histogram);
+            break;
+    }
+
+    return (float) ProfilerTicksToMicroseconds(&profileClock, ticks);
 }
 
-// get rotorPositionTailFpsMuting
-static float GetRotorPositionTailFpsMutingCallback(void *inRefcon)
+// builds the path of a file in the folder of the plugin, path has to hold 512
+// characters more than the name
+static void GetPluginFilePath(const char *name, char *path)
 {
-    return rotorPositionTailFpsMuting;
+    XPLMGetPluginInfo(XPLMGetMyID(), NULL, path, NULL, NULL);
+    char *separator = strrchr(path, XPLMGetDirectorySeparator()[0]);
+    strcpy(separator != NULL ? separator + 1 : path, name);
 }
 
-// set rotorPositionTailFpsMuting
-static void SetRotorPositionTailFpsMutingCallback(void *inRefcon, float newRotorPositionTailFpsMuting)
+// looks up the sim datarefs that are not known yet or no longer good and notes
+// the subsystems that have to be skipped because an input is missing, a
+// missing dataref is only reported when the set of skipped subsystems changes
+static void ResolveSimDataRefs(void)
 {
-    rotorPositionTailFpsMuting = newRotorPositionTailFpsMuting;
+    uint32_t skipped = 0;
+
+    for (int i = 0; i < SIM_DATAREF_COUNT; i++)
+    {
+        if (simDataRefs[i] == NULL || !XPLMIsDataRefGood(simDataRefs[i]))
+            simDataRefs[i] = XPLMFindDataRef(simDataRefDescriptors[i].name);
+        if (simDataRefs[i] == NULL)
+            skipped |= simDataRefDescriptors[i].subsystems;
+    }
+
+    if (skipped != skippedSubsystems)
+    {
+        for (int i = 0; i < SIM_DATAREF_COUNT; i++)
+        {
+            if (simDataRefs[i] == NULL)
+            {
+                XPLMDebugString(NAME ": cannot find ");
+                XPLMDebugString(simDataRefDescriptors[i].name);
+                XPLMDebugString("\n");
+            }
+        }
+
+        for (int i = 0; i < PROFILE_COUNT; i++)
+        {
+            if ((skipped ^ skippedSubsystems) & (1u << i))
+            {
+                XPLMDebugString(NAME ": ");
+                XPLMDebugString(skipped & (1u << i) ? "skipping " : "resuming ");
+                XPLMDebugString(profileNames[i]);
+                XPLMDebugString("\n");
+            }
+        }
+    }
+
+    // the doors may have missed a change of their request while skipped
+    if ((skippedSubsystems & ~skipped & (1u << PROFILE_DOORS)) && doorsFlightLoop != NULL)
+    {
+        doorsMoving = 1;
+        XPLMScheduleFlightLoop(doorsFlightLoop, -1.0f, 1);
+    }
+
+    skippedSubsystems = skipped;
 }
 
 PLUGIN_API int XPluginStart(char *outName, char *outSig, char *outDesc)
@@ -699,58 +2870,51 @@ PLUGIN_API int XPluginStart(char *outName, char *outSig, char *outDesc)
     strcpy(outSig, "de.bwravencl." NAME_LOWERCASE);
     strcpy(outDesc, NAME " provides advanced animations for the Hughes 500D!");
 
+    // load the animation tracks from the folder of the plugin
+    char tracksPath[512 + sizeof(TRACKS_FILE)];
+    GetPluginFilePath(TRACKS_FILE, tracksPath);
+    LoadTracks(tracksPath);
+#if TUNING
+    GetPluginFilePath(TUNING_FILE, tuningPath);
+#endif
+
+    ResetInstances();
+
     // register datarefs
-    doorsLeftPositionDataRef = XPLMRegisterDataAccessor("abb/doors/left/cockpit/position", xplmType_Float, 1, NULL, NULL, GetDoorsLeftPositionCallback, SetDoorsLeftPositionCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    doorsRightPositionDataRef = XPLMRegisterDataAccessor("abb/doors/right/cockpit/position", xplmType_Float, 1, NULL, NULL, GetDoorsRightPositionCallback, SetDoorsRightPositionCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    adf1DataRef = XPLMRegisterDataAccessor("abb/flags/audio/panel/adf1", xplmType_Float, 1, NULL, NULL, GetAdf1Callback, SetAdf1Callback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    adf2DataRef = XPLMRegisterDataAccessor("abb/flags/audio/panel/adf2", xplmType_Float, 1, NULL, NULL, GetAdf2Callback, SetAdf2Callback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    com1DataRef = XPLMRegisterDataAccessor("abb/flags/audio/panel/com1", xplmType_Float, 1, NULL, NULL, GetCom1Callback, SetCom1Callback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    com2DataRef = XPLMRegisterDataAccessor("abb/flags/audio/panel/com2", xplmType_Float, 1, NULL, NULL, GetCom2Callback, SetCom2Callback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    dmeDataRef = XPLMRegisterDataAccessor("abb/flags/audio/panel/dme", xplmType_Float, 1, NULL, NULL, GetDmeCallback, SetDmeCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    nav1DataRef = XPLMRegisterDataAccessor("abb/flags/audio/panel/nav1", xplmType_Float, 1, NULL, NULL, GetNav1Callback, SetNav1Callback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    nav2DataRef = XPLMRegisterDataAccessor("abb/flags/audio/panel/nav2", xplmType_Float, 1, NULL, NULL, GetNav2Callback, SetNav2Callback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    tacradsHighMainDataRef = XPLMRegisterDataAccessor("abb/flags/rotor/disc/tacrads/high/main", xplmType_Float, 1, NULL, NULL, GetTacradsHighMainCallback, SetTacradsHighMainCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    tacradsHighTailDataRef = XPLMRegisterDataAccessor("abb/flags/rotor/disc/tacrads/high/tail", xplmType_Float, 1, NULL, NULL, GetTacradsHighTailCallback, SetTacradsHighTailCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    headHeadingDataRef = XPLMRegisterDataAccessor("abb/pilot/head/heading/degrees", xplmType_Float, 1, NULL, NULL, GetHeadHeadingCallback, SetHeadHeadingCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    rotorBladesPitch0DataRef = XPLMRegisterDataAccessor("abb/rotor/blades/pitch/0", xplmType_Float, 1, NULL, NULL, GetRotorBladesPitch0Callback, SetRotorBladesPitch0Callback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    rotorBladesPitch1DataRef = XPLMRegisterDataAccessor("abb/rotor/blades/pitch/1", xplmType_Float, 1, NULL, NULL, GetRotorBladesPitch1Callback, SetRotorBladesPitch1Callback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    rotorBladesPitch2DataRef = XPLMRegisterDataAccessor("abb/rotor/blades/pitch/2", xplmType_Float, 1, NULL, NULL, GetRotorBladesPitch2Callback, SetRotorBladesPitch2Callback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    rotorBladesPitch3DataRef = XPLMRegisterDataAccessor("abb/rotor/blades/pitch/3", xplmType_Float, 1, NULL, NULL, GetRotorBladesPitch3Callback, SetRotorBladesPitch3Callback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    rotorBladesPitch4DataRef = XPLMRegisterDataAccessor("abb/rotor/blades/pitch/4", xplmType_Float, 1, NULL, NULL, GetRotorBladesPitch4Callback, SetRotorBladesPitch4Callback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    rotorMutingLowPitchDataRef = XPLMRegisterDataAccessor("abb/rotor/disc/tilt/pitch/muting/low", xplmType_Float, 1, NULL, NULL, GetRotorMutingLowPitchCallback, SetRotorMutingLowPitchCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    rotorMutingLowRollDataRef = XPLMRegisterDataAccessor("abb/rotor/disc/tilt/roll/muting/low", xplmType_Float, 1, NULL, NULL, GetRotorMutingLowRollCallback, SetRotorMutingLowRollCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    rotorPositionMainDataRef = XPLMRegisterDataAccessor("abb/rotor/position/degrees/main", xplmType_Float, 1, NULL, NULL, GetRotorPositionMainCallback, SetRotorPositionMainCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    rotorPositionMainMutingDataRef = XPLMRegisterDataAccessor("abb/rotor/position/degrees/main/muting", xplmType_Float, 1, NULL, NULL, GetRotorPositionMainMutingCallback, SetRotorPositionMainMutingCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    rotorPositionTailDataRef = XPLMRegisterDataAccessor("abb/rotor/position/degrees/tail", xplmType_Float, 1, NULL, NULL, GetRotorPositionTailCallback, SetRotorPositionTailCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    rotorPositionTailMutingDataRef = XPLMRegisterDataAccessor("abb/rotor/position/degrees/tail/muting", xplmType_Float, 1, NULL, NULL, GetRotorPositionTailMutingCallback, SetRotorPositionTailMutingCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    rotorPositionMainFpsMutingDataRef = XPLMRegisterDataAccessor("abb/rotor/position/main/fps/muting", xplmType_Float, 1, NULL, NULL, GetRotorPositionMainFpsMutingCallback, SetRotorPositionMainFpsMutingCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-    rotorPositionTailFpsMutingDataRef = XPLMRegisterDataAccessor("abb/rotor/position/tail/fps/muting", xplmType_Float, 1, NULL, NULL, GetRotorPositionTailFpsMutingCallback, SetRotorPositionTailFpsMutingCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-
-    // obtain datarefs
-    acfNumBladesDataRef = XPLMFindDataRef("sim/aircraft/prop/acf_num_blades");
-    acfCyclicAilnDataRef = XPLMFindDataRef("sim/aircraft/vtolcontrols/acf_cyclic_ailn");
-    acfCyclicElevDataRef = XPLMFindDataRef("sim/aircraft/vtolcontrols/acf_cyclic_elev");
-    audioPanelOutDataRef = XPLMFindDataRef("sim/cockpit/switches/audio_panel_out");
-    flaprqstDataRef = XPLMFindDataRef("sim/flightmodel/controls/flaprqst");
-    cyclicElevDiscTiltDataRef = XPLMFindDataRef("sim/flightmodel/cyclic/cyclic_elev_disc_tilt");
-    cyclicAilnDiscTiltDataRef = XPLMFindDataRef("sim/flightmodel/cyclic/cyclic_ailn_disc_tilt");
-    pointPitchDegDataRef = XPLMFindDataRef("sim/flightmodel/engine/POINT_pitch_deg");
-    pointTacradDataRef = XPLMFindDataRef( "sim/flightmodel/engine/POINT_tacrad");
-    ongroundAnyDataRef = XPLMFindDataRef("sim/flightmodel/failures/onground_any");
-    localXDataRef = XPLMFindDataRef("sim/flightmodel/position/local_x");
-    localZDataRef = XPLMFindDataRef("sim/flightmodel/position/local_z");
-    phiDataRef = XPLMFindDataRef("sim/flightmodel/position/phi");
-    psiDataRef = XPLMFindDataRef("sim/flightmodel/position/psi");
-    pDotDataRef = XPLMFindDataRef( "sim/flightmodel/position/P_dot");
-    qDotDataRef = XPLMFindDataRef( "sim/flightmodel/position/Q_dot");
-    viewXDataRef = XPLMFindDataRef("sim/graphics/view/view_x");
-    viewZDataRef = XPLMFindDataRef("sim/graphics/view/view_z");
-    yolkPitchRatioDataRef = XPLMFindDataRef("sim/joystick/yolk_pitch_ratio");
-    yolkRollRatioDataRef = XPLMFindDataRef("sim/joystick/yolk_roll_ratio");
-    frameRatePeriodDataRef = XPLMFindDataRef("sim/operation/misc/frame_rate_period");
-
-    // register flight loop callback
-    XPLMRegisterFlightLoopCallback(FlightLoopCallback, -1, NULL);
+    for (intptr_t i = 0; i < CHANNEL_COUNT; i++)
+    {
+        const ChannelDescriptor *descriptor = &channelDescriptors[i];
+        channelDataRefs[i] = XPLMRegisterDataAccessor(descriptor->name, descriptor->type, descriptor->writable, NULL, NULL, GetChannelCallback, descriptor->writable ? SetChannelCallback : NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, (void *) i, (void *) i);
+    }
+
+    // register profiler datarefs
+    ProfilerStartClock(&profileClock);
+    profilerEnabledDataRef = XPLMRegisterDataAccessor("abb/perf/enabled", xplmType_Int, 1, GetProfilerEnabledCallback, SetProfilerEnabledCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    for (intptr_t i = 0; i < PROFILE_COUNT * PROFILE_STAT_COUNT; i++)
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "abb/perf/%s/%s", profileNames[i / PROFILE_STAT_COUNT], profileStatNames[i % PROFILE_STAT_COUNT]);
+        profileDataRefs[i] = XPLMRegisterDataAccessor(name, xplmType_Float, 0, NULL, NULL, GetProfileCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, (void *) i, NULL);
+    }
+
+    // register telemetry datarefs
+    telemetryEnabledDataRef = XPLMRegisterDataAccessor("abb/telemetry/enabled", xplmType_Int, 1, GetTelemetryEnabledCallback, SetTelemetryEnabledCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    telemetryDroppedDataRef = XPLMRegisterDataAccessor("abb/telemetry/dropped", xplmType_Int, 0, GetTelemetryDroppedCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+
+    // register worker dataref
+    workerEnabledDataRef = XPLMRegisterDataAccessor("abb/worker/enabled", xplmType_Int, 1, GetWorkerEnabledCallback, SetWorkerEnabledCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+
+    // register governor dataref
+    governorLevelDataRef = XPLMRegisterDataAccessor("abb/governor/level", xplmType_Int, 0, GetGovernorLevelCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+
+    // register shared data dataref
+    shareEnabledDataRef = XPLMRegisterDataAccessor("abb/share/enabled", xplmType_Int, 1, GetShareEnabledCallback, SetShareEnabledCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+
+    // create menu
+    pluginMenuItem = XPLMAppendMenuItem(XPLMFindPluginsMenu(), NAME, NULL, 1);
+    pluginMenu = XPLMCreateMenu(NAME, XPLMFindPluginsMenu(), pluginMenuItem, MenuHandlerCallback, NULL);
+    overlayMenuItem = XPLMAppendMenuItem(pluginMenu, "Performance Overlay", (void *) MENU_ITEM_OVERLAY, 1);
+    XPLMCheckMenuItem(pluginMenu, overlayMenuItem, xplm_Menu_Unchecked);
 
     return 1;
 }
@@ -758,42 +2922,105 @@ PLUGIN_API int XPluginStart(char *outName, char *outSig, char *outDesc)
 PLUGIN_API void	XPluginStop(void)
 {
     // unregister datarefs
-    XPLMUnregisterDataAccessor(doorsLeftPositionDataRef);
-    XPLMUnregisterDataAccessor(doorsRightPositionDataRef);
-    XPLMUnregisterDataAccessor(adf1DataRef);
-    XPLMUnregisterDataAccessor(adf2DataRef);
-    XPLMUnregisterDataAccessor(com1DataRef);
-    XPLMUnregisterDataAccessor(com2DataRef);
-    XPLMUnregisterDataAccessor(dmeDataRef);
-    XPLMUnregisterDataAccessor(nav1DataRef);
-    XPLMUnregisterDataAccessor(nav2DataRef);
-    XPLMUnregisterDataAccessor(tacradsHighMainDataRef);
-    XPLMUnregisterDataAccessor(tacradsHighTailDataRef);
-    XPLMUnregisterDataAccessor(headHeadingDataRef);
-    XPLMUnregisterDataAccessor(rotorBladesPitch0DataRef);
-    XPLMUnregisterDataAccessor(rotorBladesPitch1DataRef);
-    XPLMUnregisterDataAccessor(rotorBladesPitch2DataRef);
-    XPLMUnregisterDataAccessor(rotorBladesPitch3DataRef);
-    XPLMUnregisterDataAccessor(rotorBladesPitch4DataRef);
-    XPLMUnregisterDataAccessor(rotorMutingLowPitchDataRef);
-    XPLMUnregisterDataAccessor(rotorMutingLowRollDataRef);
-    XPLMUnregisterDataAccessor(rotorPositionMainDataRef);
-    XPLMUnregisterDataAccessor(rotorPositionMainMutingDataRef);
-    XPLMUnregisterDataAccessor(rotorPositionTailDataRef);
-    XPLMUnregisterDataAccessor(rotorPositionTailMutingDataRef);
-    XPLMUnregisterDataAccessor(rotorPositionMainFpsMutingDataRef);
-    XPLMUnregisterDataAccessor(rotorPositionTailFpsMutingDataRef);
+    for (int i = 0; i < CHANNEL_COUNT; i++)
+        XPLMUnregisterDataAccessor(channelDataRefs[i]);
+
+    // destroy overlay and menu
+    delete perfOverlay;
+    perfOverlay = NULL;
+    XPLMDestroyMenu(pluginMenu);
+    XPLMRemoveMenuItem(XPLMFindPluginsMenu(), pluginMenuItem);
+
+    // unregister telemetry
+    XPLMUnregisterDataAccessor(telemetryEnabledDataRef);
+    XPLMUnregisterDataAccessor(telemetryDroppedDataRef);
+
+    // unregister worker
+    XPLMUnregisterDataAccessor(workerEnabledDataRef);
+
+    // unregister governor
+    XPLMUnregisterDataAccessor(governorLevelDataRef);
+
+    // unregister shared data
+    XPLMUnregisterDataAccessor(shareEnabledDataRef);
+
+    // dump and unregister profiler
+    DumpProfile();
+    XPLMUnregisterDataAccessor(profilerEnabledDataRef);
+    for (int i = 0; i < PROFILE_COUNT * PROFILE_STAT_COUNT; i++)
+        XPLMUnregisterDataAccessor(profileDataRefs[i]);
 }
 
 PLUGIN_API void XPluginDisable(void)
 {
+    // hide overlay
+    SetPerfOverlayVisible(0);
+
+    // hand the state back to the sim thread, the worker restarts with the
+    // flight loops once the plugin is enabled
+    StopWorker();
+
+    // stop telemetry, it resumes into a new file when the plugin is enabled
+    StopTelemetry();
+
+    // stop sharing, the shared data keeps its last values while disabled
+    StopShare();
+
+    // destroy flight loops
+    DestroyFlightLoop(&shudderFlightLoop);
+    DestroyFlightLoop(&frameFlightLoop);
+    DestroyFlightLoop(&pilotFlightLoop);
+    DestroyFlightLoop(&switchesFlightLoop);
+    DestroyFlightLoop(&doorsFlightLoop);
+    DestroyFlightLoop(&workerFlightLoop);
+#if TUNING
+    DestroyFlightLoop(&tuningFlightLoop);
+#endif
 }
 
 PLUGIN_API int XPluginEnable(void)
 {
+    // the sim datarefs are looked up before the first frame that needs them
+    ResolveSimDataRefs();
+
+#if TUNING
+    // read the tuning before the first frame and watch it for changes
+    LoadTuning();
+    tuningFlightLoop = CreateFlightLoop(xplm_FlightLoop_Phase_BeforeFlightModel, TuningFlightLoopCallback, TUNING_CHECK_INTERVAL);
+#endif
+
+    // create flight loops, the shudder has to reach the flight model in the
+    // same frame while everything else reads what the flight model computed
+    shudderFlightLoop = CreateFlightLoop(xplm_FlightLoop_Phase_BeforeFlightModel, ShudderFlightLoopCallback, -1.0f);
+    frameFlightLoop = CreateFlightLoop(xplm_FlightLoop_Phase_AfterFlightModel, FrameFlightLoopCallback, -1.0f);
+#if SCHEDULED_UPDATE
+    pilotFlightLoop = CreateFlightLoop(xplm_FlightLoop_Phase_AfterFlightModel, PilotFlightLoopCallback, -1.0f);
+    switchesFlightLoop = CreateFlightLoop(xplm_FlightLoop_Phase_AfterFlightModel, SwitchesFlightLoopCallback, -1.0f);
+
+    // run the doors once so that they settle into the current request
+    doorsMoving = 1;
+    doorsFlightLoop = CreateFlightLoop(xplm_FlightLoop_Phase_AfterFlightModel, DoorsFlightLoopCallback, -1.0f);
+#endif
+
+#if WORKER
+    // the worker is handed each frame after all of its subsystems have run
+    workerFlightLoop = CreateFlightLoop(xplm_FlightLoop_Phase_AfterFlightModel, WorkerFlightLoopCallback, -1.0f);
+#endif
+
+    // share the channels after the worker has published its results
+    if (shareRequested)
+        StartShare();
+
+    // start telemetry last, so that it records the results of all other loops
+    if (telemetryRequested)
+        StartTelemetry();
+
     return 1;
 }
 
 PLUGIN_API void XPluginReceiveMessage(XPLMPluginID inFromWho, long inMessage, void *inParam)
 {
+    // the aircraft may publish datarefs of its own or take others with it
+    if (inMessage == XPLM_MSG_PLANE_LOADED && (intptr_t) inParam == XPLM_USER_AIRCRAFT)
+        ResolveSimDataRefs();
 }
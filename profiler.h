@@ -0,0 +1,186 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// timing histograms for the update subsystems
+//
+// samples are taken in ticks of the time stamp counter and sorted into
+// logarithmic bins with 8 sub-bins per power of two, so a percentile is
+// accurate to within 1/16 of its value; ticks are only converted to
+// microseconds when a result is read, against the monotonic clock
+//
+// every histogram keeps two windows of PROFILER_WINDOW samples, results cover
+// the previous and the current window, so they roll with the last 1 to 2
+// windows of samples in fixed memory
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// define window length in samples
+#ifndef PROFILER_WINDOW
+#define PROFILER_WINDOW 1024
+#endif
+
+// define bin layout
+#define PROFILER_SUB_BIN_BITS 3
+#define PROFILER_SUB_BINS (1 << PROFILER_SUB_BIN_BITS)
+#define PROFILER_BINS ((64 - PROFILER_SUB_BIN_BITS + 1) * PROFILER_SUB_BINS)
+
+struct ProfileWindow
+{
+    uint32_t bins[PROFILER_BINS];
+    uint32_t count;
+    uint64_t max;
+};
+
+struct ProfileHistogram
+{
+    ProfileWindow windows[2];
+    int current;
+    uint64_t total;
+    uint64_t totalTicks;
+};
+
+// reference point for converting ticks into time
+struct ProfileClock
+{
+    uint64_t startTicks;
+    double startSeconds;
+};
+
+inline static double ProfilerSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// reads the time stamp counter, or the monotonic clock in nanoseconds where
+// there is none
+inline static uint64_t ProfilerTicks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+inline static void ProfilerStartClock(ProfileClock *clock)
+{
+    clock->startTicks = ProfilerTicks();
+    clock->startSeconds = ProfilerSeconds();
+}
+
+// converts ticks into microseconds, the tick rate is measured over the time
+// since the clock was started
+inline static double ProfilerTicksToMicroseconds(const ProfileClock *clock, double ticks)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    double seconds = ProfilerSeconds() - clock->startSeconds;
+    uint64_t elapsedTicks = ProfilerTicks() - clock->startTicks;
+    if (seconds <= 0.0 || elapsedTicks == 0)
+        return 0.0;
+
+    return ticks * seconds * 1e6 / elapsedTicks;
+#else
+    return ticks * 1e-3;
+#endif
+}
+
+inline static int ProfilerBin(uint64_t ticks)
+{
+    if (ticks < PROFILER_SUB_BINS)
+        return (int) ticks;
+
+    int exponent = 63 - __builtin_clzll(ticks);
+    int shift = exponent - PROFILER_SUB_BIN_BITS;
+
+    return (shift + 1) * PROFILER_SUB_BINS + (int) ((ticks >> shift) & (PROFILER_SUB_BINS - 1));
+}
+
+// midpoint of the ticks sorted into a bin
+inline static double ProfilerBinValue(int bin)
+{
+    if (bin < PROFILER_SUB_BINS)
+        return bin;
+
+    int shift = bin / PROFILER_SUB_BINS - 1;
+    uint64_t lower = (uint64_t) (PROFILER_SUB_BINS + bin % PROFILER_SUB_BINS) << shift;
+
+    return lower + ((uint64_t) 1 << shift) * 0.5;
+}
+
+inline static void ProfilerRecord(ProfileHistogram *histogram, uint64_t ticks)
+{
+    ProfileWindow *window = &histogram->windows[histogram->current];
+
+    if (window->count == PROFILER_WINDOW)
+    {
+        histogram->current ^= 1;
+        window = &histogram->windows[histogram->current];
+        memset(window, 0, sizeof(ProfileWindow));
+    }
+
+    window->bins[ProfilerBin(ticks)]++;
+    window->count++;
+    if (ticks > window->max)
+        window->max = ticks;
+    histogram->total++;
+    histogram->totalTicks += ticks;
+}
+
+// returns the given percentile of both windows in ticks, 0 without samples
+inline static double ProfilerPercentile(const ProfileHistogram *histogram, double percentile)
+{
+    uint32_t count = histogram->windows[0].count + histogram->windows[1].count;
+    if (count == 0)
+        return 0.0;
+
+    uint32_t rank = (uint32_t) (percentile * 0.01 * (count - 1)) + 1;
+    uint32_t seen = 0;
+
+    for (int bin = 0; bin < PROFILER_BINS; bin++)
+    {
+        seen += histogram->windows[0].bins[bin] + histogram->windows[1].bins[bin];
+        if (seen >= rank)
+            return ProfilerBinValue(bin);
+    }
+
+    return ProfilerBinValue(PROFILER_BINS - 1);
+}
+
+// returns the maximum of both windows in ticks
+inline static double ProfilerMax(const ProfileHistogram *histogram)
+{
+    uint64_t max0 = histogram->windows[0].max, max1 = histogram->windows[1].max;
+
+    return (double) (max0 > max1 ? max0 : max1);
+}
+
+#endif
@@ -0,0 +1,235 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+// append-only telemetry file fed through a lock-free ring buffer
+//
+// the producer copies fixed size records into a single-producer/single-consumer
+// ring that is allocated when the writer is opened; pushing never blocks,
+// allocates or enters the kernel, a full ring drops the record and counts it
+//
+// a background thread polls the ring and appends the records to the file
+// through a shared mapping that grows in TELEMETRY_CHUNK_SIZE steps, when the
+// writer is closed the file is truncated to the bytes actually written
+
+#include <atomic>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+// define writer parameters
+#define TELEMETRY_CHUNK_SIZE (16 * 1024 * 1024)
+#define TELEMETRY_POLL_NANOSECONDS 10000000
+
+struct TelemetryRing
+{
+    alignas(64) std::atomic<uint32_t> head;
+    alignas(64) std::atomic<uint32_t> tail;
+    alignas(64) std::atomic<uint32_t> dropped;
+    uint32_t capacity;
+    uint32_t recordSize;
+    unsigned char *records;
+};
+
+struct TelemetryWriter
+{
+    TelemetryRing ring;
+    int fd;
+    unsigned char *chunk;
+    uint64_t chunkOffset;
+    uint64_t chunkUsed;
+    uint64_t bytesWritten;
+    int failed;
+    std::atomic<int> running;
+    pthread_t thread;
+};
+
+// copies a record into the ring, returns 0 and counts the record as dropped if
+// the ring is full; only ever called from the producer thread
+inline static int TelemetryPush(TelemetryRing *ring, const void *record)
+{
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+    uint32_t tail = ring->tail.load(std::memory_order_acquire);
+
+    if (head - tail == ring->capacity)
+    {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    memcpy(ring->records + (size_t) (head & (ring->capacity - 1)) * ring->recordSize, record, ring->recordSize);
+    ring->head.store(head + 1, std::memory_order_release);
+
+    return 1;
+}
+
+// maps the chunk of the file that starts at chunkOffset, growing the file
+inline static int TelemetryMapChunk(TelemetryWriter *writer)
+{
+    if (ftruncate(writer->fd, (off_t) (writer->chunkOffset + TELEMETRY_CHUNK_SIZE)) != 0)
+        return 0;
+
+    void *chunk = mmap(NULL, TELEMETRY_CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, writer->fd, (off_t) writer->chunkOffset);
+    if (chunk == MAP_FAILED)
+        return 0;
+
+    writer->chunk = (unsigned char *) chunk;
+    writer->chunkUsed = 0;
+
+    return 1;
+}
+
+// appends bytes to the file, moving on to the next chunk where needed
+inline static void TelemetryAppend(TelemetryWriter *writer, const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *) data;
+
+    while (size > 0 && !writer->failed)
+    {
+        if (writer->chunkUsed == TELEMETRY_CHUNK_SIZE)
+        {
+            munmap(writer->chunk, TELEMETRY_CHUNK_SIZE);
+            writer->chunk = NULL;
+            writer->chunkOffset += TELEMETRY_CHUNK_SIZE;
+
+            if (!TelemetryMapChunk(writer))
+            {
+                writer->failed = 1;
+                return;
+            }
+        }
+
+        size_t n = TELEMETRY_CHUNK_SIZE - writer->chunkUsed;
+        if (n > size)
+            n = size;
+
+        memcpy(writer->chunk + writer->chunkUsed, bytes, n);
+        writer->chunkUsed += n;
+        writer->bytesWritten += n;
+        bytes += n;
+        size -= n;
+    }
+}
+
+// moves every record in the ring into the file, returns the number of records
+inline static uint32_t TelemetryDrain(TelemetryWriter *writer)
+{
+    TelemetryRing *ring = &writer->ring;
+    uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint32_t head = ring->head.load(std::memory_order_acquire);
+
+    for (uint32_t i = tail; i != head; i++)
+        TelemetryAppend(writer, ring->records + (size_t) (i & (ring->capacity - 1)) * ring->recordSize, ring->recordSize);
+
+    ring->tail.store(head, std::memory_order_release);
+
+    return head - tail;
+}
+
+inline static void *TelemetryThread(void *arg)
+{
+    TelemetryWriter *writer = (TelemetryWriter *) arg;
+    struct timespec pollInterval = {0, TELEMETRY_POLL_NANOSECONDS};
+
+    for (;;)
+    {
+        // a final drain after the producer has stopped catches every record
+        int running = writer->running.load(std::memory_order_acquire);
+
+        uint32_t drained = TelemetryDrain(writer);
+
+        if (!running)
+            break;
+
+        if (drained == 0)
+            nanosleep(&pollInterval, NULL);
+    }
+
+    return NULL;
+}
+
+// creates the file at path, writes the header and starts the writer thread,
+// capacity is the number of records the ring holds and must be a power of two
+inline static int TelemetryOpen(TelemetryWriter *writer, const char *path, const void *header, size_t headerSize, uint32_t recordSize, uint32_t capacity)
+{
+    writer->ring.head.store(0);
+    writer->ring.tail.store(0);
+    writer->ring.dropped.store(0);
+    writer->ring.capacity = capacity;
+    writer->ring.recordSize = recordSize;
+    writer->ring.records = (unsigned char *) malloc((size_t) capacity * recordSize);
+    writer->chunk = NULL;
+    writer->chunkOffset = 0;
+    writer->bytesWritten = 0;
+    writer->failed = 0;
+
+    if (writer->ring.records == NULL)
+        return 0;
+
+    writer->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (writer->fd < 0)
+    {
+        free(writer->ring.records);
+        return 0;
+    }
+
+    if (!TelemetryMapChunk(writer))
+    {
+        close(writer->fd);
+        free(writer->ring.records);
+        return 0;
+    }
+
+    TelemetryAppend(writer, header, headerSize);
+
+    writer->running.store(1);
+    if (pthread_create(&writer->thread, NULL, TelemetryThread, writer) != 0)
+    {
+        munmap(writer->chunk, TELEMETRY_CHUNK_SIZE);
+        close(writer->fd);
+        free(writer->ring.records);
+        return 0;
+    }
+
+    return 1;
+}
+
+// stops the writer thread once it has drained the ring and closes the file,
+// returns 0 if anything could not be written
+inline static int TelemetryClose(TelemetryWriter *writer)
+{
+    writer->running.store(0, std::memory_order_release);
+    pthread_join(writer->thread, NULL);
+
+    if (writer->chunk != NULL)
+        munmap(writer->chunk, TELEMETRY_CHUNK_SIZE);
+    if (ftruncate(writer->fd, (off_t) writer->bytesWritten) != 0)
+        writer->failed = 1;
+    close(writer->fd);
+    free(writer->ring.records);
+
+    return !writer->failed;
+}
+
+#endif
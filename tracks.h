@@ -0,0 +1,332 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef TRACKS_H
+#define TRACKS_H
+
+// keyframe tracks for articulated parts
+//
+// a track is a list of keys, each with a time in seconds, a value and an
+// optional slope in units per second; the segment between two keys is a cubic
+// hermite curve if both of them carry a slope and a straight line otherwise,
+// two keys at the same time make a corner; before its first and after its last
+// key a track holds the value of that key
+//
+// tracks are written as text, one key per line below the track it belongs to,
+// with anything after a # ignored:
+//
+//   # the step folds out in half a second and overshoots a little
+//   track step
+//   0.0   0.0   0.0
+//   0.4   1.05
+//   0.5   1.0   0.0
+//
+// and compiled into one flat table of segments, each stored as the polynomial
+// over the time since its start; evaluation keeps a cursor on the segment it
+// last used and steps it forward or back, so a track that is played forward
+// costs one polynomial and two compares per call no matter how many keys it has
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// define limits
+#define MAX_TRACKS 256
+#define MAX_TRACK_SEGMENTS 4096
+#define TRACK_NAME_LENGTH 32
+#define TRACK_LINE_LENGTH 256
+
+struct TrackSegment
+{
+    float start;
+    float end;
+    float coefficients[4];
+};
+
+// the segments of a track are the count segments of the table from first on
+struct Track
+{
+    char name[TRACK_NAME_LENGTH];
+    int first;
+    int count;
+    float startTime;
+    float endTime;
+    float startValue;
+    float endValue;
+};
+
+struct TrackTable
+{
+    int trackCount;
+    int segmentCount;
+    Track tracks[MAX_TRACKS];
+    TrackSegment segments[MAX_TRACK_SEGMENTS];
+};
+
+// key of the track being compiled
+struct TrackKey
+{
+    double time;
+    double value;
+    double slope;
+    int hasSlope;
+};
+
+inline static int TrackError(char *error, size_t errorSize, int line, const char *message, const char *detail)
+{
+    snprintf(error, errorSize, "line %d: %s%s", line, message, detail);
+    return 0;
+}
+
+// evaluates a segment at time seconds after its start
+inline static float TrackSegmentValue(const TrackSegment *segment, float time)
+{
+    const float *c = segment->coefficients;
+
+    return c[0] + time * (c[1] + time * (c[2] + time * c[3]));
+}
+
+// appends the segment between two keys of the last track, keys at the same
+// time only start the next segment
+inline static int TrackAppendSegment(TrackTable *table, const TrackKey *from, const TrackKey *to)
+{
+    Track *track = &table->tracks[table->trackCount - 1];
+    track->endTime = (float) to->time;
+    track->endValue = (float) to->value;
+
+    double duration = to->time - from->time;
+    if (duration <= 0.0)
+        return 1;
+
+    if (table->segmentCount == MAX_TRACK_SEGMENTS)
+        return 0;
+
+    TrackSegment *segment = &table->segments[table->segmentCount++];
+    track->count++;
+
+    double slope = (to->value - from->value) / duration;
+    segment->start = (float) from->time;
+    segment->end = (float) to->time;
+    segment->coefficients[0] = (float) from->value;
+    if (from->hasSlope && to->hasSlope)
+    {
+        segment->coefficients[1] = (float) from->slope;
+        segment->coefficients[2] = (float) ((3.0 * slope - 2.0 * from->slope - to->slope) / duration);
+        segment->coefficients[3] = (float) ((from->slope + to->slope - 2.0 * slope) / (duration * duration));
+    }
+    else
+    {
+        segment->coefficients[1] = (float) slope;
+        segment->coefficients[2] = 0.0f;
+        segment->coefficients[3] = 0.0f;
+    }
+
+    return 1;
+}
+
+// compiles tracks from text, returns 0 and describes the first problem in
+// error if the text is not valid, the table is then unusable
+inline static int TrackCompile(TrackTable *table, const char *text, char *error, size_t errorSize)
+{
+    memset(table, 0, sizeof(TrackTable));
+
+    TrackKey previous;
+    int keys = 0, line = 0;
+
+    for (const char *next = text; *next != '\0';)
+    {
+        const char *end = strchr(next, '\n');
+        if (end == NULL)
+            end = next + strlen(next);
+
+        char buffer[TRACK_LINE_LENGTH];
+        size_t length = end - next;
+        line++;
+        if (length >= sizeof(buffer))
+            return TrackError(error, errorSize, line, "line too long", "");
+        memcpy(buffer, next, length);
+        buffer[length] = '\0';
+        next = *end == '\0' ? end : end + 1;
+
+        char *comment = strchr(buffer, '#');
+        if (comment != NULL)
+            *comment = '\0';
+
+        char *token = strtok(buffer, " \t\r");
+        if (token == NULL)
+            continue;
+
+        if (strcmp(token, "track") == 0)
+        {
+            const char *name = strtok(NULL, " \t\r");
+            if (table->trackCount > 0 && keys == 0)
+                return TrackError(error, errorSize, line, "no keys in track ", table->tracks[table->trackCount - 1].name);
+            if (name == NULL || strlen(name) >= TRACK_NAME_LENGTH || strtok(NULL, " \t\r") != NULL)
+                return TrackError(error, errorSize, line, "expected a track name", "");
+            if (table->trackCount == MAX_TRACKS)
+                return TrackError(error, errorSize, line, "too many tracks", "");
+            for (int i = 0; i < table->trackCount; i++)
+            {
+                if (strcmp(table->tracks[i].name, name) == 0)
+                    return TrackError(error, errorSize, line, "duplicate track ", name);
+            }
+
+            Track *track = &table->tracks[table->trackCount++];
+            strcpy(track->name, name);
+            track->first = table->segmentCount;
+            keys = 0;
+            continue;
+        }
+
+        if (table->trackCount == 0)
+            return TrackError(error, errorSize, line, "key outside of a track", "");
+
+        double numbers[3];
+        int count = 0;
+        for (; token != NULL; token = strtok(NULL, " \t\r"))
+        {
+            char *rest;
+            double number = strtod(token, &rest);
+            if (count == 3 || *rest != '\0' || !isfinite(number))
+                return TrackError(error, errorSize, line, "expected time, value and optional slope", "");
+            numbers[count++] = number;
+        }
+        if (count < 2)
+            return TrackError(error, errorSize, line, "expected time, value and optional slope", "");
+
+        TrackKey key;
+        key.time = numbers[0];
+        key.value = numbers[1];
+        key.slope = count == 3 ? numbers[2] : 0.0;
+        key.hasSlope = count == 3;
+
+        if (keys == 0)
+        {
+            Track *track = &table->tracks[table->trackCount - 1];
+            track->startTime = track->endTime = (float) key.time;
+            track->startValue = track->endValue = (float) key.value;
+        }
+        else if (key.time < previous.time)
+            return TrackError(error, errorSize, line, "key before the previous one", "");
+        else if (!TrackAppendSegment(table, &previous, &key))
+            return TrackError(error, errorSize, line, "too many segments", "");
+
+        previous = key;
+        keys++;
+    }
+
+    if (table->trackCount > 0 && keys == 0)
+        return TrackError(error, errorSize, line, "no keys in track ", table->tracks[table->trackCount - 1].name);
+
+    return 1;
+}
+
+// returns the index of the track with the given name, -1 if there is none
+inline static int TrackFind(const TrackTable *table, const char *name)
+{
+    for (int i = 0; i < table->trackCount; i++)
+    {
+        if (strcmp(table->tracks[i].name, name) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+// evaluates a track at time, cursor is the index of the segment within the
+// track that the previous call used and is moved to the one used now; any
+// cursor gives the same value, a close one just finds the segment sooner
+inline static float TrackEvaluate(const TrackTable *table, int track, float time, int *cursor)
+{
+    const Track *t = &table->tracks[track];
+    if (time <= t->startTime || t->count == 0)
+        return t->startValue;
+    if (time >= t->endTime)
+        return t->endValue;
+
+    const TrackSegment *segments = table->segments + t->first;
+    int i = *cursor;
+    i = i < 0 ? 0 : i >= t->count ? t->count - 1 : i;
+    while (time >= segments[i].end)
+        i++;
+    while (time < segments[i].start)
+        i--;
+    *cursor = i;
+
+    return TrackSegmentValue(&segments[i], time - segments[i].start);
+}
+
+// returns the earliest time at which a track reaches value and puts cursor on
+// its segment, or the end of the track if it never does; this walks the track
+// from its start, so it is meant for jumping onto a track, not for playing it
+inline static float TrackSeek(const TrackTable *table, int track, float value, int *cursor)
+{
+    const Track *t = &table->tracks[track];
+    const TrackSegment *segments = table->segments + t->first;
+
+    *cursor = 0;
+    if (t->count == 0 || value == t->startValue)
+        return t->startTime;
+
+    for (int i = 0; i < t->count; i++)
+    {
+        const TrackSegment *segment = &segments[i];
+        float duration = segment->end - segment->start;
+        float low = segment->coefficients[0] - value;
+        float high = TrackSegmentValue(segment, duration) - value;
+        if ((low < 0.0f) == (high < 0.0f) && high != 0.0f)
+            continue;
+
+        // the crossing is bisected, which is exact enough for any value that
+        // the segment passes only once
+        float from = 0.0f, to = duration;
+        for (int j = 0; j < 24; j++)
+        {
+            float middle = 0.5f * (from + to);
+            if ((TrackSegmentValue(segment, middle) - value < 0.0f) == (low < 0.0f))
+                from = middle;
+            else
+                to = middle;
+        }
+
+        *cursor = i;
+        return segment->start + to;
+    }
+
+    *cursor = t->count - 1;
+    return t->endTime;
+}
+
+// checksum of a compiled table, tells apart tables compiled from different text
+inline static uint32_t TrackChecksum(const TrackTable *table)
+{
+    uint32_t hash = 2166136261u;
+    const unsigned char *bytes[2] = {(const unsigned char *) table->tracks, (const unsigned char *) table->segments};
+    size_t sizes[2] = {table->trackCount * sizeof(Track), table->segmentCount * sizeof(TrackSegment)};
+
+    for (int i = 0; i < 2; i++)
+    {
+        for (size_t j = 0; j < sizes[i]; j++)
+            hash = (hash ^ bytes[i][j]) * 16777619u;
+    }
+
+    return hash;
+}
+
+#endif
@@ -0,0 +1,127 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef WORKER_H
+#define WORKER_H
+
+// persistent thread that runs one job at a time on behalf of its owner
+//
+// the owner hands the job over with WorkerSubmit and must not touch it again
+// until WorkerWait has returned; the handoff goes through a mutex, so whatever
+// the owner wrote before submitting is visible to the job and whatever the job
+// wrote is visible to the owner once the wait returns, the job itself needs no
+// synchronization; between jobs the thread sleeps on a condition variable
+
+#include <pthread.h>
+
+typedef void (*WorkerRun_f)(void *job);
+
+struct Worker
+{
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t submitted;
+    pthread_cond_t completed;
+    WorkerRun_f run;
+    void *job;
+    int pending;
+    int running;
+};
+
+inline static void *WorkerThread(void *arg)
+{
+    Worker *worker = (Worker *) arg;
+
+    pthread_mutex_lock(&worker->mutex);
+    for (;;)
+    {
+        while (!worker->pending && worker->running)
+            pthread_cond_wait(&worker->submitted, &worker->mutex);
+
+        // a job submitted before the worker was stopped still runs
+        if (!worker->pending)
+            break;
+
+        pthread_mutex_unlock(&worker->mutex);
+        worker->run(worker->job);
+        pthread_mutex_lock(&worker->mutex);
+
+        worker->pending = 0;
+        pthread_cond_signal(&worker->completed);
+    }
+    pthread_mutex_unlock(&worker->mutex);
+
+    return NULL;
+}
+
+// starts the thread that runs the given job every time it is submitted
+inline static int WorkerStart(Worker *worker, WorkerRun_f run, void *job)
+{
+    worker->run = run;
+    worker->job = job;
+    worker->pending = 0;
+    worker->running = 1;
+
+    pthread_mutex_init(&worker->mutex, NULL);
+    pthread_cond_init(&worker->submitted, NULL);
+    pthread_cond_init(&worker->completed, NULL);
+
+    if (pthread_create(&worker->thread, NULL, WorkerThread, worker) != 0)
+    {
+        pthread_cond_destroy(&worker->completed);
+        pthread_cond_destroy(&worker->submitted);
+        pthread_mutex_destroy(&worker->mutex);
+        return 0;
+    }
+
+    return 1;
+}
+
+// hands the job to the thread, the previous one has to be waited for first
+inline static void WorkerSubmit(Worker *worker)
+{
+    pthread_mutex_lock(&worker->mutex);
+    worker->pending = 1;
+    pthread_cond_signal(&worker->submitted);
+    pthread_mutex_unlock(&worker->mutex);
+}
+
+// waits until the submitted job has run, returns at once if there is none
+inline static void WorkerWait(Worker *worker)
+{
+    pthread_mutex_lock(&worker->mutex);
+    while (worker->pending)
+        pthread_cond_wait(&worker->completed, &worker->mutex);
+    pthread_mutex_unlock(&worker->mutex);
+}
+
+// lets the thread finish a submitted job and stops it
+inline static void WorkerStop(Worker *worker)
+{
+    pthread_mutex_lock(&worker->mutex);
+    worker->running = 0;
+    pthread_cond_signal(&worker->submitted);
+    pthread_mutex_unlock(&worker->mutex);
+
+    pthread_join(worker->thread, NULL);
+
+    pthread_cond_destroy(&worker->completed);
+    pthread_cond_destroy(&worker->submitted);
+    pthread_mutex_destroy(&worker->mutex);
+}
+
+#endif